@@ -0,0 +1,78 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN      8
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    ArenaBlock *b = arena->blocks;
+    if (!b || b->cap - b->used < size) {
+        /* Oversized requests get a block of their own */
+        size_t cap = size > ARENA_BLOCK_SIZE / 4 ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock *nb = malloc(sizeof(ArenaBlock) + cap);
+        if (!nb) return NULL;
+        nb->used = 0;
+        nb->cap = cap;
+
+        if (b && cap == size) {
+            /* Keep filling the current block afterwards */
+            nb->next = b->next;
+            b->next = nb;
+        } else {
+            nb->next = b;
+            arena->blocks = nb;
+        }
+        b = nb;
+    }
+
+    void *p = b->data + b->used;
+    b->used += size;
+    arena->bytes_used += size;
+    return p;
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t len) {
+    char *p = arena_alloc(arena, len + 1);
+    if (!p) return NULL;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+    return arena_strndup(arena, s, strlen(s));
+}
+
+void arena_free_all(Arena *arena) {
+    ArenaBlock *b = arena->blocks;
+    while (b) {
+        ArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+    arena->blocks = NULL;
+    arena->bytes_used = 0;
+}
+
+void arena_reset(Arena *arena) {
+    ArenaBlock *keep = NULL;
+    for (ArenaBlock *b = arena->blocks; b; b = b->next)
+        if (!keep || b->cap > keep->cap) keep = b;
+
+    ArenaBlock *b = arena->blocks;
+    while (b) {
+        ArenaBlock *next = b->next;
+        if (b != keep) free(b);
+        b = next;
+    }
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    arena->blocks = keep;
+    arena->bytes_used = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* -------- Bump allocator: many small records, freed all at once -------- */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t cap;
+    unsigned char data[];
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock *blocks;           // newest block first
+    size_t bytes_used;            // sum of all allocations
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+char *arena_strdup(Arena *arena, const char *s);
+void  arena_free_all(Arena *arena);
+
+/* Drop every allocation but keep the largest block for reuse: scratch
+   memory that is refilled over and over stops calling malloc */
+void  arena_reset(Arena *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bytebuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // write, fsync, close, unlink
+
+/* =============== OUTPUT BUFFER =================== */
+
+int buf_reserve(ByteBuf *b, size_t extra) {
+    if (b->failed) return -1;
+    if (b->len + extra <= b->cap) return 0;
+
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + extra) cap *= 2;
+
+    unsigned char *p = realloc(b->data, cap);
+    if (!p) {
+        b->failed = 1;
+        return -1;
+    }
+    b->data = p;
+    b->cap = cap;
+    return 0;
+}
+
+void buf_put(ByteBuf *b, const void *src, size_t n) {
+    if (n == 0 || buf_reserve(b, n) != 0) return;
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+void buf_put_uint(ByteBuf *b, uint64_t v, int width) {
+    unsigned char tmp[8];
+    for (int i = 0; i < width; i++)
+        tmp[i] = (unsigned char)(v >> (8 * i));
+    buf_put(b, tmp, (size_t)width);
+}
+
+/* LEB128: 7 bits per byte, high bit set on all but the last */
+void buf_put_varint(ByteBuf *b, uint64_t v) {
+    unsigned char tmp[10];
+    int n = 0;
+    do {
+        unsigned char byte = v & 0x7f;
+        v >>= 7;
+        tmp[n++] = v ? (byte | 0x80) : byte;
+    } while (v);
+    buf_put(b, tmp, (size_t)n);
+}
+
+void buf_free(ByteBuf *b) {
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+/* =============== READER =================== */
+
+uint64_t rd_uint(Reader *r, int width) {
+    if (!r->ok || r->end - r->p < width) {
+        r->ok = 0;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < width; i++)
+        v |= (uint64_t)r->p[i] << (8 * i);
+    r->p += width;
+    return v;
+}
+
+uint64_t rd_varint(Reader *r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (!r->ok || r->p >= r->end) break;
+        unsigned char byte = *r->p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return v;
+    }
+    r->ok = 0;
+    return 0;
+}
+
+const unsigned char *rd_bytes(Reader *r, size_t n) {
+    if (!r->ok || (size_t)(r->end - r->p) < n) {
+        r->ok = 0;
+        return NULL;
+    }
+    const unsigned char *at = r->p;
+    r->p += n;
+    return at;
+}
+
+/* =============== ATOMIC FILE REPLACE =================== */
+
+int write_file_atomic(const char *path, const void *data, size_t len) {
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return -1;
+
+    const unsigned char *p = (const unsigned char *)data;
+    size_t off = 0;
+    while (off < len) {
+        ssize_t w = write(fd, p + off, len - off);
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+
+    if (off != len || fsync(fd) != 0) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef BYTEBUF_H
+#define BYTEBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* -------- Growable output buffer (little-endian encoders) -------- */
+typedef struct ByteBuf {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    int failed;                   // set once an allocation failed
+} ByteBuf;
+
+int  buf_reserve(ByteBuf *b, size_t extra);
+void buf_put(ByteBuf *b, const void *src, size_t n);
+void buf_put_uint(ByteBuf *b, uint64_t v, int width);
+void buf_put_varint(ByteBuf *b, uint64_t v);
+void buf_free(ByteBuf *b);
+
+/* -------- Bounds-checked reader over a mapped file -------- */
+typedef struct Reader {
+    const unsigned char *p;
+    const unsigned char *end;
+    int ok;                       // cleared on overrun / bad encoding
+} Reader;
+
+uint64_t rd_uint(Reader *r, int width);
+uint64_t rd_varint(Reader *r);
+const unsigned char *rd_bytes(Reader *r, size_t n);
+
+/* Write to <path>.tmp, fsync, then rename over path. 0 on success. */
+int write_file_atomic(const char *path, const void *data, size_t len);
+
+#endif /* BYTEBUF_H */
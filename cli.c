@@ -1,13 +1,18 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 
 #include "cli.h"
 #include "trie_index.h"
 #include "minigit.h"
+#include "gc.h"
 #include "search_engine.h"
 #include "autocomplete.h"
 #include "ranking.h"
+#include "repo_store.h"
 
 /* Prototypes for helper functions implemented elsewhere */
 int extract_matching_line(const char *filename,
@@ -26,18 +31,25 @@ void print_help() {
     printf("\n--- Mini-Git & Smart Search Engine ---\n");
     printf("Mini-Git Commands:\n");
     printf("  init                      - Initialize a new repository.\n");
-    printf("  add <filename>            - Add a file to the staging area.\n");
+    printf("  add <path>                - Stage a file, or every file under a directory.\n");
     printf("  commit \"<message>\"        - Commit staged files.\n");
-    printf("  log                       - View commit history.\n");
-    printf("  view <commit_id>          - View details of a specific commit.\n");
-    printf("  delete <commit_id>        - Delete a commit.\n");
+    printf("  log [count]               - View commit history (newest first).\n");
+    printf("  view <commit_id|hash>     - View details of a specific commit.\n");
+    printf("  delete <commit_id|hash>   - Delete a commit.\n");
+    printf("  ancestor <a> <b>          - Check whether commit a is an ancestor of b.\n");
+    printf("  repack                    - Rebuild the delta-compressed pack.\n");
+    printf("  gc                        - Delete unreachable objects and report reclaimed bytes.\n");
+    printf("  compression [level]       - Show or set object compression (0 = off, 1-9).\n");
+    printf("  train-dict                - Train a compression dictionary on the head commit.\n");
     printf("\nSearch Engine Commands:\n");
     printf("  search <term>             - Perform full search with ranking.\n");
     printf("  suggest <prefix>          - Get autocomplete suggestions.\n");
     printf("\nWorking Copy / Simple VCS Commands:\n");
-    printf("  checkout <commit_id>      - Load files from a commit into working directory.\n");
+    printf("  checkout <commit_id|hash> - Load files from a commit into working directory.\n");
     printf("  edit <filename>           - Edit a file in the working directory (simple editor).\n");
     printf("  save \"message\"            - Commit all files from working directory.\n");
+    printf("  status                    - Show changes in working directory since last commit.\n");
+    printf("  diff [--histogram] a [b]  - Line diff of commit a against commit b or .mgit_work/.\n");
     printf("\nGeneral Commands:\n");
     printf("  help                      - Show this help message.\n");
     printf("  exit                      - Quit the application.\n\n");
@@ -90,6 +102,19 @@ void handle_suggest(const char *term) {
     printf("\n");
 }
 
+/* Wait for the next command no longer than the group commit window
+   of logged changes; if it runs out first, sync them */
+static void wait_for_command(void) {
+    int ms = repo_store_sync_wait_ms();
+    if (ms < 0) return;
+
+    struct pollfd in = { 0, POLLIN, 0 };
+    fflush(stdout);
+    if (ms > 0 && poll(&in, 1, ms) > 0) return;
+    if (repo_store_sync_due() != 0)
+        printf("Warning: could not sync %s\n", REPO_WAL);
+}
+
 int main() {
     char input[MAX_INPUT_BUFFER];
     char *command, *argument;
@@ -104,6 +129,7 @@ int main() {
 
     while (1) {
         printf("cli> ");
+        wait_for_command();
 
         if (!fgets(input, sizeof(input), stdin)) {
             break;
@@ -126,23 +152,41 @@ int main() {
         }
         else if (strcmp(command, "add") == 0) {
             argument ? add_file(argument)
-                     : printf("Usage: add <filename>\n");
+                     : printf("Usage: add <path>\n");
         }
         else if (strcmp(command, "commit") == 0) {
             argument ? commit_staged(argument)
                      : printf("Usage: commit \"<message>\"\n");
         }
         else if (strcmp(command, "log") == 0) {
-            view_log();
+            view_log(argument ? atoi(argument) : 0);
         }
         else if (strcmp(command, "view") == 0) {
-            argument ? view_commit(atoi(argument))
+            argument ? view_commit(resolve_commit_ref(argument))
                      : printf("Usage: view <commit_id>\n");
         }
         else if (strcmp(command, "delete") == 0) {
-            argument ? delete_commit(atoi(argument))
+            argument ? delete_commit(resolve_commit_ref(argument))
                      : printf("Usage: delete <commit_id>\n");
         }
+        else if (strcmp(command, "ancestor") == 0) {
+            char *a = argument ? strtok(argument, " ") : NULL;
+            char *b = a ? strtok(NULL, " ") : NULL;
+            b ? check_ancestry(a, b)
+              : printf("Usage: ancestor <commit_id|hash> <commit_id|hash>\n");
+        }
+        else if (strcmp(command, "repack") == 0) {
+            repack_repository();
+        }
+        else if (strcmp(command, "gc") == 0) {
+            collect_garbage();
+        }
+        else if (strcmp(command, "compression") == 0) {
+            set_compression(argument);
+        }
+        else if (strcmp(command, "train-dict") == 0) {
+            train_compression_dict();
+        }
         else if (strcmp(command, "search") == 0) {
             argument ? handle_search(argument)
                      : printf("Usage: search <term>\n");
@@ -152,13 +196,27 @@ int main() {
                      : printf("Usage: suggest <prefix>\n");
         }
         else if (strcmp(command, "checkout") == 0) {
-            argument ? checkout_commit(atoi(argument))
+            argument ? checkout_commit(resolve_commit_ref(argument))
                      : printf("Usage: checkout <commit_id>\n");
         }
         else if (strcmp(command, "edit") == 0) {
             argument ? edit_file(argument)
                      : printf("Usage: edit <filename>\n");
         }
+        else if (strcmp(command, "diff") == 0) {
+            DiffAlgorithm alg = DIFF_MYERS;
+            char *a = argument ? strtok(argument, " ") : NULL;
+            if (a && (strcmp(a, "--histogram") == 0 || strcmp(a, "--patience") == 0)) {
+                alg = DIFF_HISTOGRAM;
+                a = strtok(NULL, " ");
+            }
+            char *b = a ? strtok(NULL, " ") : NULL;
+            a ? diff_commits(a, b, alg)
+              : printf("Usage: diff [--histogram] <commit_id|hash> [commit_id|hash]\n");
+        }
+        else if (strcmp(command, "status") == 0) {
+            show_status();
+        }
         else if (strcmp(command, "save") == 0) {
             argument ? save_commit(argument)
                      : printf("Usage: save \"message\"\n");
@@ -167,8 +225,12 @@ int main() {
             printf("Unknown command: '%s'. Type 'help' for assistance.\n",
                    command);
         }
+
+        /* A cycle started by delete advances one bounded slice per command */
+        if (gc_active()) gc_step(GC_STEP_BUDGET);
     }
 
+    close_repository();
     cleanup_ranking_system();
     cleanup_autocomplete_system();
     cleanup_search_engine();
@@ -0,0 +1,371 @@
+#include "codec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_MATCH     4
+#define LAST_LITERALS 5               // a block always ends in this many literals
+#define MF_LIMIT      12              // no match may start this close to the end
+#define MAX_OFFSET    65535
+#define HASH_LOG_MAX  15
+#define HASH_LOG_MIN  10
+#define WINDOW_MAX    (CODEC_DICT_MAX + CODEC_MAX_BLOCK)
+
+/* Chain probes per level; lazy matching from level 5 on */
+static const int level_attempts[CODEC_MAX_LEVEL + 1] = { 0, 1, 4, 8, 16, 32, 64, 128, 256, 512 };
+#define LAZY_LEVEL 5
+
+struct CodecScratch {
+    int32_t head[1 << HASH_LOG_MAX];          // newest position per hash, -1 if none
+    uint16_t chain[WINDOW_MAX];               // distance to the previous same-hash position
+    unsigned char window[WINDOW_MAX];         // dictionary tail + block, when a dict is used
+    int hash_log;
+    size_t next_insert;
+};
+
+CodecScratch *codec_scratch_new(void) {
+    return malloc(sizeof(CodecScratch));
+}
+
+void codec_scratch_free(CodecScratch *s) {
+    free(s);
+}
+
+size_t codec_bound(size_t n) {
+    return n + n / 255 + 16;
+}
+
+/* =============== COMPRESS =================== */
+
+static uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint32_t hash4(const unsigned char *p, int hash_log) {
+    return (read32(p) * 2654435761u) >> (32 - hash_log);
+}
+
+static void insert_upto(CodecScratch *s, const unsigned char *base, size_t pos) {
+    for (size_t i = s->next_insert; i < pos; i++) {
+        uint32_t h = hash4(base + i, s->hash_log);
+        int32_t prev = s->head[h];
+        size_t delta = prev >= 0 ? i - (size_t)prev : 0;
+        s->chain[i] = (uint16_t)(delta <= MAX_OFFSET ? delta : 0);
+        s->head[h] = (int32_t)i;
+    }
+    if (pos > s->next_insert) s->next_insert = pos;
+}
+
+static size_t match_length(const unsigned char *a, const unsigned char *b, const unsigned char *a_end) {
+    const unsigned char *start = a;
+    while (a + 8 <= a_end) {
+        uint64_t x, y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        if (x != y) break;
+        a += 8;
+        b += 8;
+    }
+    while (a < a_end && *a == *b) {
+        a++;
+        b++;
+    }
+    return (size_t)(a - start);
+}
+
+/* Longest earlier match for the bytes at ip, ending by limit */
+static size_t find_match(CodecScratch *s, const unsigned char *base, size_t ip,
+                         size_t limit, int attempts, size_t *match_pos) {
+    insert_upto(s, base, ip);
+
+    size_t best = 0;
+    int32_t cand = s->head[hash4(base + ip, s->hash_log)];
+    while (cand >= 0 && attempts-- > 0) {
+        size_t c = (size_t)cand;
+        if (ip - c > MAX_OFFSET) break;
+
+        if ((ip + best >= limit || base[c + best] == base[ip + best]) &&
+            read32(base + c) == read32(base + ip)) {
+            size_t len = match_length(base + ip, base + c, base + limit);
+            if (len > best) {
+                best = len;
+                *match_pos = c;
+                if (ip + len >= limit) break;
+            }
+        }
+
+        uint16_t delta = s->chain[c];
+        if (delta == 0) break;
+        cand = (int32_t)(c - delta);
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+static unsigned char *put_length(unsigned char *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+static unsigned char *put_sequence(unsigned char *op, const unsigned char *lit, size_t lit_len,
+                                   size_t offset, size_t match_len) {
+    unsigned char *token = op++;
+    size_t ml = match_len ? match_len - MIN_MATCH : 0;
+
+    *token = (unsigned char)((lit_len >= 15 ? 15 : lit_len) << 4 | (ml >= 15 ? 15 : ml));
+    if (lit_len >= 15) op = put_length(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len) {
+        *op++ = (unsigned char)(offset & 0xff);
+        *op++ = (unsigned char)(offset >> 8);
+        if (ml >= 15) op = put_length(op, ml - 15);
+    }
+    return op;
+}
+
+size_t codec_compress(CodecScratch *s, const unsigned char *src, size_t n,
+                      unsigned char *dst, int level, const CodecDict *dict) {
+    if (level < CODEC_MIN_LEVEL) level = CODEC_MIN_LEVEL;
+    if (level > CODEC_MAX_LEVEL) level = CODEC_MAX_LEVEL;
+    if (n > CODEC_MAX_BLOCK) n = CODEC_MAX_BLOCK;
+
+    /* The dictionary tail and the block share one address space so
+       matches may start in one and run into the other */
+    const unsigned char *base = src;
+    size_t start = 0;
+    if (dict && dict->len > 0) {
+        start = dict->len < CODEC_DICT_MAX ? dict->len : CODEC_DICT_MAX;
+        memcpy(s->window, dict->data + dict->len - start, start);
+        memcpy(s->window + start, src, n);
+        base = s->window;
+    }
+    size_t end = start + n;
+
+    s->hash_log = HASH_LOG_MIN;
+    while (s->hash_log < HASH_LOG_MAX && ((size_t)1 << s->hash_log) < end)
+        s->hash_log++;
+    memset(s->head, 0xff, sizeof(int32_t) << s->hash_log);
+    s->next_insert = 0;
+
+    unsigned char *op = dst;
+    size_t anchor = start, ip = start;
+
+    if (n >= MF_LIMIT + 1) {
+        size_t mf_limit = end - MF_LIMIT;
+        size_t limit = end - LAST_LITERALS;
+        int attempts = level_attempts[level];
+
+        while (ip < mf_limit) {
+            size_t ref = 0;
+            size_t len = find_match(s, base, ip, limit, attempts, &ref);
+            if (!len) {
+                ip++;
+                continue;
+            }
+
+            /* One byte later may start a longer match; take it if so */
+            if (level >= LAZY_LEVEL && ip + 1 < mf_limit) {
+                size_t ref2 = 0;
+                size_t len2 = find_match(s, base, ip + 1, limit, attempts, &ref2);
+                if (len2 > len + 1) {
+                    ip++;
+                    len = len2;
+                    ref = ref2;
+                }
+            }
+
+            while (ip > anchor && ref > 0 && base[ip - 1] == base[ref - 1]) {
+                ip--;
+                ref--;
+                len++;
+            }
+
+            op = put_sequence(op, base + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+        }
+    }
+
+    op = put_sequence(op, base + anchor, end - anchor, 0, 0);
+    return (size_t)(op - dst);
+}
+
+/* =============== DECOMPRESS =================== */
+
+static int get_length(const unsigned char **ip, const unsigned char *iend, size_t *len) {
+    unsigned b;
+    do {
+        if (*ip >= iend) return -1;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+int codec_decompress(const unsigned char *src, size_t n,
+                     unsigned char *dst, size_t dst_len, const CodecDict *dict) {
+    const unsigned char *ip = src, *iend = src + n;
+    unsigned char *op = dst, *oend = dst + dst_len;
+
+    while (ip < iend) {
+        unsigned token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && get_length(&ip, iend, &lit) != 0) return -1;
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) return -1;
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) break;                    // the last sequence has no match
+
+        if (iend - ip < 2) return -1;
+        size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+
+        size_t len = token & 15;
+        if (len == 15 && get_length(&ip, iend, &len) != 0) return -1;
+        len += MIN_MATCH;
+        if (offset == 0 || len > (size_t)(oend - op)) return -1;
+
+        size_t produced = (size_t)(op - dst);
+        if (offset > produced) {
+            /* The match starts inside the dictionary */
+            size_t back = offset - produced;
+            if (!dict || back > dict->len) return -1;
+            size_t from_dict = back < len ? back : len;
+            memcpy(op, dict->data + dict->len - back, from_dict);
+            op += from_dict;
+            len -= from_dict;
+            for (const unsigned char *m = dst; len > 0; len--) *op++ = *m++;
+        } else if (offset >= len) {
+            memcpy(op, op - offset, len);
+            op += len;
+        } else {
+            const unsigned char *m = op - offset;   // overlapping: repeats a run
+            while (len-- > 0) *op++ = *m++;
+        }
+    }
+    return op == oend ? 0 : -1;
+}
+
+/* =============== DICTIONARY TRAINING =================== */
+/* A cut-down COVER: score every SEGMENT-byte window by how many other
+   samples share its DMER-byte substrings, keep the best window of each
+   equal slice of the sample data, and stop counting the substrings a
+   kept window already covers. */
+
+#define DMER      8
+#define SEGMENT   64
+#define FREQ_LOG  20
+
+typedef struct Segment {
+    const unsigned char *data;
+    uint64_t score;
+} Segment;
+
+static uint32_t dmer_hash(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - FREQ_LOG));
+}
+
+static uint64_t dmer_score(const uint32_t *freq, const unsigned char *p) {
+    uint32_t f = freq[dmer_hash(p)];
+    return f > 1 ? f : 0;                         // seen in one sample only: no help
+}
+
+static int cmp_segment(const void *a, const void *b) {
+    uint64_t x = ((const Segment *)a)->score, y = ((const Segment *)b)->score;
+    return (x > y) - (x < y);
+}
+
+/* Best window starting in [lo, hi) of one sample */
+static void best_window(const uint32_t *freq, const unsigned char *p, size_t lo, size_t hi,
+                        Segment *best) {
+    uint64_t score = 0;
+    for (size_t i = lo; i + DMER <= lo + SEGMENT; i++)
+        score += dmer_score(freq, p + i);
+
+    for (size_t w = lo;; w++) {
+        if (score > best->score) {
+            best->score = score;
+            best->data = p + w;
+        }
+        if (w + 1 >= hi) break;
+        score -= dmer_score(freq, p + w);
+        score += dmer_score(freq, p + w + SEGMENT - DMER + 1);
+    }
+}
+
+size_t codec_train_dict(const unsigned char *const *samples, const size_t *sizes,
+                        int count, unsigned char *dict, size_t cap) {
+    if (cap > CODEC_DICT_MAX) cap = CODEC_DICT_MAX;
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += sizes[i];
+    size_t nseg = cap / SEGMENT;
+    if (nseg == 0 || total < 4 * SEGMENT) return 0;
+
+    uint32_t *freq = calloc((size_t)1 << FREQ_LOG, sizeof(uint32_t));
+    uint32_t *seen = calloc((size_t)1 << FREQ_LOG, sizeof(uint32_t));
+    Segment *segs = malloc(nseg * sizeof(Segment));
+    if (!freq || !seen || !segs) {
+        free(freq);
+        free(seen);
+        free(segs);
+        return 0;
+    }
+
+    /* Document frequency: each d-mer counts once per sample */
+    for (int s = 0; s < count; s++) {
+        for (size_t i = 0; i + DMER <= sizes[s]; i++) {
+            uint32_t h = dmer_hash(samples[s] + i);
+            if (seen[h] == (uint32_t)s + 1) continue;
+            seen[h] = (uint32_t)s + 1;
+            freq[h]++;
+        }
+    }
+    free(seen);
+
+    /* One segment per epoch: an equal slice of the samples laid end to end */
+    size_t kept = 0, sample = 0, sample_start = 0;
+    for (size_t e = 0; e < nseg; e++) {
+        size_t a = total / nseg * e;
+        size_t b = e + 1 == nseg ? total : total / nseg * (e + 1);
+        Segment best = { NULL, 0 };
+
+        while (sample < (size_t)count && sample_start + sizes[sample] <= a) {
+            sample_start += sizes[sample];
+            sample++;
+        }
+        for (size_t s = sample, off = sample_start; s < (size_t)count && off < b; off += sizes[s], s++) {
+            if (sizes[s] < SEGMENT) continue;
+            size_t lo = a > off ? a - off : 0;
+            size_t hi = b - off < sizes[s] - SEGMENT + 1 ? b - off : sizes[s] - SEGMENT + 1;
+            if (lo < hi) best_window(freq, samples[s], lo, hi, &best);
+        }
+        if (!best.data) continue;
+
+        for (size_t i = 0; i + DMER <= SEGMENT; i++)
+            freq[dmer_hash(best.data + i)] = 0;
+        segs[kept++] = best;
+    }
+
+    qsort(segs, kept, sizeof(Segment), cmp_segment);
+    size_t len = 0;
+    for (size_t i = 0; i < kept; i++) {
+        memcpy(dict + len, segs[i].data, SEGMENT);
+        len += SEGMENT;
+    }
+
+    free(freq);
+    free(segs);
+    return len;
+}
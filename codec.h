@@ -0,0 +1,57 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* -------- Block compressor for stored objects -------- */
+/* LZ77 in the LZ4 block format: a token byte (literal run length,
+ * match length), the literals, a 16-bit offset, length extensions in
+ * 255-byte steps. Decoding is a tight loop of memcpys with no entropy
+ * stage, which is what checkout and search read paths want.
+ *
+ * Levels trade compression time only; every level decodes at the same
+ * speed. Level 1 is a greedy single-probe search, higher levels walk
+ * longer hash chains (and look one byte ahead from level 5 on).
+ *
+ * A dictionary is treated as data preceding every block, so small
+ * files can refer to content typical of the repository (see
+ * codec_train_dict).
+ */
+#define CODEC_MAX_BLOCK     (64 * 1024)   // input bytes per block (window size)
+#define CODEC_MIN_LEVEL     1
+#define CODEC_MAX_LEVEL     9
+#define CODEC_DEFAULT_LEVEL 1
+#define CODEC_DICT_MAX      (32 * 1024)
+
+typedef struct CodecDict {
+    uint32_t id;                  // identifies the dictionary in stored objects
+    const unsigned char *data;
+    size_t len;
+} CodecDict;
+
+typedef struct CodecScratch CodecScratch;   // per-thread compressor state
+
+CodecScratch *codec_scratch_new(void);
+void   codec_scratch_free(CodecScratch *s);
+
+/* Worst-case compressed size of an n-byte block */
+size_t codec_bound(size_t n);
+
+/* Compress n <= CODEC_MAX_BLOCK bytes into dst (codec_bound(n) bytes).
+   Returns the compressed length. dict may be NULL. */
+size_t codec_compress(CodecScratch *s, const unsigned char *src, size_t n,
+                      unsigned char *dst, int level, const CodecDict *dict);
+
+/* Decode a block that must expand to exactly dst_len bytes.
+   Returns 0, or -1 on corrupt input or a missing dictionary. */
+int    codec_decompress(const unsigned char *src, size_t n,
+                        unsigned char *dst, size_t dst_len, const CodecDict *dict);
+
+/* Pick the byte segments that recur most across the samples and lay
+   them out best-last (closest to the data, shortest offsets). Returns
+   the dictionary length, 0 if there is too little sample data. */
+size_t codec_train_dict(const unsigned char *const *samples, const size_t *sizes,
+                        int count, unsigned char *dict, size_t cap);
+
+#endif /* CODEC_H */
@@ -0,0 +1,226 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "commit_graph.h"
+#include "minigit.h"
+#include "bytebuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat
+
+#define GRAPH_MAGIC    "MGITCGR"
+#define GRAPH_VERSION  1
+#define HEADER_SIZE    12
+#define ROW_SIZE       48
+
+/* =============== LOOKUP =================== */
+
+const GraphRow *commit_graph_find(const CommitGraph *g, int commit_id) {
+    int lo = 0, hi = g->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int id = g->rows[mid].commit_id;
+        if (id == commit_id) return &g->rows[mid];
+        if (id < commit_id) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+const GraphRow *commit_graph_tip(const CommitGraph *g) {
+    return g->count ? &g->rows[g->count - 1] : NULL;
+}
+
+const GraphRow *commit_graph_parent(const CommitGraph *g, const GraphRow *row) {
+    return row->parent_id ? commit_graph_find(g, row->parent_id) : NULL;
+}
+
+int commit_graph_is_ancestor(const CommitGraph *g, int ancestor_id, int descendant_id) {
+    const GraphRow *anc = commit_graph_find(g, ancestor_id);
+    const GraphRow *row = commit_graph_find(g, descendant_id);
+    if (!anc || !row) return -1;
+
+    /* Everything below anc's generation is too old to lead back to it */
+    while (row && row->generation > anc->generation)
+        row = commit_graph_parent(g, row);
+    return row == anc;
+}
+
+/* =============== UPDATE =================== */
+
+static int reserve_rows(CommitGraph *g, int n) {
+    if (n <= g->cap) return 0;
+    int cap = g->cap ? g->cap : 64;
+    while (cap < n) cap *= 2;
+    GraphRow *p = realloc(g->rows, (size_t)cap * sizeof(GraphRow));
+    if (!p) return -1;
+    g->rows = p;
+    g->cap = cap;
+    return 0;
+}
+
+static void fill_row(GraphRow *row, const Commit *c) {
+    row->commit_id = c->commit_id;
+    row->parent_id = c->parent_id;
+    row->generation = 1;
+    row->timestamp = c->timestamp;
+    row->hash = c->hash;
+    row->message = c->message;
+    row->message_len = strlen(c->message);
+}
+
+/* Parents always have lower ids, so one pass in id order suffices */
+static void compute_generations(CommitGraph *g) {
+    for (int i = 0; i < g->count; i++) {
+        GraphRow *row = &g->rows[i];
+        const GraphRow *parent = commit_graph_parent(g, row);
+        row->generation = parent ? parent->generation + 1 : 1;
+    }
+}
+
+static int cmp_row_id(const void *a, const void *b) {
+    int x = ((const GraphRow *)a)->commit_id;
+    int y = ((const GraphRow *)b)->commit_id;
+    return (x > y) - (x < y);
+}
+
+int commit_graph_rebuild(CommitGraph *g, const Commit *head) {
+    int n = 0;
+    for (const Commit *c = head; c; c = c->next) n++;
+
+    g->count = 0;
+    if (reserve_rows(g, n) != 0) return -1;
+    for (const Commit *c = head; c; c = c->next)
+        fill_row(&g->rows[g->count++], c);
+
+    qsort(g->rows, (size_t)g->count, sizeof(GraphRow), cmp_row_id);
+    compute_generations(g);
+    return 0;
+}
+
+int commit_graph_append(CommitGraph *g, const Commit *c) {
+    const GraphRow *tip = commit_graph_tip(g);
+    if (tip && tip->commit_id >= c->commit_id) return -1;
+    if (reserve_rows(g, g->count + 1) != 0) return -1;
+
+    GraphRow *row = &g->rows[g->count++];
+    fill_row(row, c);
+    const GraphRow *parent = commit_graph_parent(g, row);
+    row->generation = parent ? parent->generation + 1 : 1;
+    return 0;
+}
+
+/* Mirror delete_commit(): the child is reparented onto the grandparent */
+void commit_graph_remove(CommitGraph *g, int commit_id) {
+    const GraphRow *victim = commit_graph_find(g, commit_id);
+    if (!victim) return;
+
+    int slot = (int)(victim - g->rows);
+    int parent_id = victim->parent_id;
+    for (int i = slot + 1; i < g->count; i++)
+        if (g->rows[i].parent_id == commit_id)
+            g->rows[i].parent_id = parent_id;
+
+    memmove(&g->rows[slot], &g->rows[slot + 1],
+            (size_t)(g->count - slot - 1) * sizeof(GraphRow));
+    g->count--;
+    compute_generations(g);
+}
+
+/* =============== LOAD / WRITE =================== */
+
+void commit_graph_clear(CommitGraph *g) {
+    free(g->rows);
+    if (g->map) munmap(g->map, g->map_len);
+    memset(g, 0, sizeof(*g));
+}
+
+int commit_graph_load(CommitGraph *g, const char *path) {
+    commit_graph_clear(g);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    Reader rd = { (const unsigned char *)map, (const unsigned char *)map + len, 1 };
+    const unsigned char *magic = rd_bytes(&rd, 7);
+    int version = (int)rd_uint(&rd, 1);
+    uint32_t count = (uint32_t)rd_uint(&rd, 4);
+
+    if (!rd.ok || memcmp(magic, GRAPH_MAGIC, 7) != 0 || version != GRAPH_VERSION ||
+        count > (len - HEADER_SIZE) / ROW_SIZE || reserve_rows(g, (int)count) != 0) {
+        munmap(map, len);
+        return -1;
+    }
+
+    const char *pool = (const char *)map + HEADER_SIZE + (size_t)count * ROW_SIZE;
+    size_t pool_len = len - HEADER_SIZE - (size_t)count * ROW_SIZE;
+
+    for (uint32_t i = 0; i < count; i++) {
+        GraphRow *row = &g->rows[i];
+        row->commit_id = (int)rd_uint(&rd, 4);
+        row->parent_id = (int)rd_uint(&rd, 4);
+        row->generation = (uint32_t)rd_uint(&rd, 4);
+        row->timestamp = (long)(int64_t)rd_uint(&rd, 8);
+        const unsigned char *hash = rd_bytes(&rd, OBJECT_ID_RAWSZ);
+        size_t off = (size_t)rd_uint(&rd, 4);
+        size_t mlen = (size_t)rd_uint(&rd, 4);
+
+        /* Messages are stored NUL-terminated so rows can point into the map */
+        if (!rd.ok || off > pool_len || mlen >= pool_len - off || pool[off + mlen] != '\0' ||
+            (i > 0 && row->commit_id <= g->rows[i - 1].commit_id)) {
+            munmap(map, len);
+            g->count = 0;
+            return -1;
+        }
+        memcpy(row->hash.hash, hash, OBJECT_ID_RAWSZ);
+        row->message = pool + off;
+        row->message_len = mlen;
+        g->count++;
+    }
+
+    g->map = map;
+    g->map_len = len;
+    return g->count;
+}
+
+int commit_graph_write(const CommitGraph *g, const char *path) {
+    ByteBuf b = {0};
+    size_t off = 0;
+
+    buf_put(&b, GRAPH_MAGIC, 7);
+    buf_put_uint(&b, GRAPH_VERSION, 1);
+    buf_put_uint(&b, (uint32_t)g->count, 4);
+
+    for (int i = 0; i < g->count; i++) {
+        const GraphRow *row = &g->rows[i];
+        buf_put_uint(&b, (uint32_t)row->commit_id, 4);
+        buf_put_uint(&b, (uint32_t)row->parent_id, 4);
+        buf_put_uint(&b, row->generation, 4);
+        buf_put_uint(&b, (uint64_t)(int64_t)row->timestamp, 8);
+        buf_put(&b, row->hash.hash, OBJECT_ID_RAWSZ);
+        buf_put_uint(&b, off, 4);
+        buf_put_uint(&b, row->message_len, 4);
+        off += row->message_len + 1;
+    }
+    for (int i = 0; i < g->count; i++)
+        buf_put(&b, g->rows[i].message, g->rows[i].message_len + 1);
+
+    int rc = b.failed ? -1 : write_file_atomic(path, b.data, b.len);
+    buf_free(&b);
+    return rc;
+}
@@ -0,0 +1,61 @@
+#ifndef COMMIT_GRAPH_H
+#define COMMIT_GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "object_store.h"
+
+struct Commit;
+
+/* Commit-graph file: what log and ancestry queries need, without the
+ * file lists of the full commit records.
+ *
+ *   header  "MGITCGR" version(1) count(4)
+ *   rows    count x { id(4) parent(4) generation(4) timestamp(8)
+ *                     hash(20) msg_off(4) msg_len(4) }, sorted by id
+ *   pool    messages (msg_off is relative to the pool)
+ *
+ * Generation numbers: a root commit is 1, any other commit is its
+ * parent's + 1, so an ancestor always has a lower generation and a walk
+ * can stop as soon as it drops below the target's.
+ */
+typedef struct GraphRow {
+    int commit_id;
+    int parent_id;                // 0 for a root commit
+    uint32_t generation;
+    long timestamp;
+    ObjectId hash;
+    const char *message;          // in the mapped file or the repo arena
+    size_t message_len;
+} GraphRow;
+
+typedef struct CommitGraph {
+    GraphRow *rows;               // sorted by commit_id
+    int count;
+    int cap;
+    void *map;                    // mapped file backing loaded messages
+    size_t map_len;
+} CommitGraph;
+
+/* Returns number of rows loaded, 0 if missing, -1 if corrupt */
+int  commit_graph_load(CommitGraph *g, const char *path);
+int  commit_graph_write(const CommitGraph *g, const char *path);   // 0 on success
+void commit_graph_clear(CommitGraph *g);
+
+/* Rebuild from the in-memory history (newest first via ->next) */
+int  commit_graph_rebuild(CommitGraph *g, const struct Commit *head);
+
+/* Keep in step with the history: c must be newer than every row */
+int  commit_graph_append(CommitGraph *g, const struct Commit *c);
+void commit_graph_remove(CommitGraph *g, int commit_id);
+
+const GraphRow *commit_graph_find(const CommitGraph *g, int commit_id);
+const GraphRow *commit_graph_tip(const CommitGraph *g);
+const GraphRow *commit_graph_parent(const CommitGraph *g, const GraphRow *row);
+
+/* 1 if ancestor_id is reachable from descendant_id through parent links
+   (a commit counts as its own ancestor), 0 if not, -1 if either is unknown */
+int  commit_graph_is_ancestor(const CommitGraph *g, int ancestor_id, int descendant_id);
+
+#endif /* COMMIT_GRAPH_H */
@@ -0,0 +1,156 @@
+#include "commit_index.h"
+#include "minigit.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define INITIAL_ID_CAP 64
+
+/* =============== ID TABLE (linear probing) =================== */
+
+static size_t slot_of(int commit_id, size_t cap) {
+    /* Fibonacci hashing spreads the dense 1..n ids over the table */
+    return (size_t)(((uint32_t)commit_id * 2654435769u)) & (cap - 1);
+}
+
+static int grow_id_table(CommitIndex *idx) {
+    size_t new_cap = idx->id_cap ? idx->id_cap * 2 : INITIAL_ID_CAP;
+    Commit **slots = calloc(new_cap, sizeof(Commit *));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < idx->id_cap; i++) {
+        Commit *c = idx->by_id[i];
+        if (!c) continue;
+        size_t s = slot_of(c->commit_id, new_cap);
+        while (slots[s]) s = (s + 1) & (new_cap - 1);
+        slots[s] = c;
+    }
+
+    free(idx->by_id);
+    idx->by_id = slots;
+    idx->id_cap = new_cap;
+    return 0;
+}
+
+void commit_index_insert(CommitIndex *idx, Commit *c) {
+    if ((idx->count + 1) * 4 > idx->id_cap * 3 && grow_id_table(idx) != 0)
+        return;
+
+    size_t s = slot_of(c->commit_id, idx->id_cap);
+    while (idx->by_id[s] && idx->by_id[s]->commit_id != c->commit_id)
+        s = (s + 1) & (idx->id_cap - 1);
+
+    if (!idx->by_id[s]) idx->count++;
+    idx->by_id[s] = c;
+    idx->by_hash_dirty = 1;
+}
+
+Commit *commit_index_find(const CommitIndex *idx, int commit_id) {
+    if (!idx->by_id) return NULL;
+
+    size_t s = slot_of(commit_id, idx->id_cap);
+    while (idx->by_id[s]) {
+        if (idx->by_id[s]->commit_id == commit_id) return idx->by_id[s];
+        s = (s + 1) & (idx->id_cap - 1);
+    }
+    return NULL;
+}
+
+/* Backward-shift deletion keeps probe chains intact without tombstones */
+void commit_index_remove(CommitIndex *idx, int commit_id) {
+    if (!idx->by_id) return;
+
+    size_t mask = idx->id_cap - 1;
+    size_t s = slot_of(commit_id, idx->id_cap);
+    while (idx->by_id[s] && idx->by_id[s]->commit_id != commit_id)
+        s = (s + 1) & mask;
+    if (!idx->by_id[s]) return;
+
+    size_t hole = s;
+    for (size_t j = (hole + 1) & mask; idx->by_id[j]; j = (j + 1) & mask) {
+        size_t home = slot_of(idx->by_id[j]->commit_id, idx->id_cap);
+        /* Move j into the hole unless its home lies cyclically in (hole, j] */
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            idx->by_id[hole] = idx->by_id[j];
+            hole = j;
+        }
+    }
+    idx->by_id[hole] = NULL;
+    idx->count--;
+    idx->by_hash_dirty = 1;
+}
+
+/* =============== HASH-PREFIX INDEX =================== */
+
+static int cmp_commit_hash(const void *a, const void *b) {
+    const Commit *ca = *(Commit * const *)a;
+    const Commit *cb = *(Commit * const *)b;
+    return memcmp(ca->hash.hash, cb->hash.hash, OBJECT_ID_RAWSZ);
+}
+
+static int rebuild_by_hash(CommitIndex *idx) {
+    Commit **sorted = idx->count ? malloc(idx->count * sizeof(Commit *)) : NULL;
+    if (idx->count && !sorted) return -1;
+
+    size_t n = 0;
+    for (size_t i = 0; i < idx->id_cap; i++)
+        if (idx->by_id[i]) sorted[n++] = idx->by_id[i];
+    qsort(sorted, n, sizeof(Commit *), cmp_commit_hash);
+
+    free(idx->by_hash);
+    idx->by_hash = sorted;
+    idx->by_hash_count = n;
+    idx->by_hash_dirty = 0;
+    return 0;
+}
+
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    ch = (char)tolower((unsigned char)ch);
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    return -1;
+}
+
+/* -1 / 0 / 1 comparing the first len nibbles of hash with the prefix */
+static int cmp_prefix(const ObjectId *id, const char *prefix, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        int nib = (i & 1) ? (id->hash[i / 2] & 0xf) : (id->hash[i / 2] >> 4);
+        int want = hex_value(prefix[i]);
+        if (nib != want) return nib < want ? -1 : 1;
+    }
+    return 0;
+}
+
+Commit *commit_index_find_prefix(CommitIndex *idx, const char *prefix, int *ambiguous) {
+    size_t len = strlen(prefix);
+    if (ambiguous) *ambiguous = 0;
+    if (len == 0 || len > OBJECT_ID_HEXSZ) return NULL;
+    for (size_t i = 0; i < len; i++)
+        if (hex_value(prefix[i]) < 0) return NULL;
+
+    if (idx->by_hash_dirty && rebuild_by_hash(idx) != 0) return NULL;
+
+    /* Lower bound: first commit whose hash is >= prefix */
+    size_t lo = 0, hi = idx->by_hash_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cmp_prefix(&idx->by_hash[mid]->hash, prefix, len) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (lo >= idx->by_hash_count || cmp_prefix(&idx->by_hash[lo]->hash, prefix, len) != 0)
+        return NULL;
+    if (lo + 1 < idx->by_hash_count &&
+        cmp_prefix(&idx->by_hash[lo + 1]->hash, prefix, len) == 0) {
+        if (ambiguous) *ambiguous = 1;
+        return NULL;
+    }
+    return idx->by_hash[lo];
+}
+
+void commit_index_clear(CommitIndex *idx) {
+    free(idx->by_id);
+    free(idx->by_hash);
+    memset(idx, 0, sizeof(*idx));
+}
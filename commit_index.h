@@ -0,0 +1,32 @@
+#ifndef COMMIT_INDEX_H
+#define COMMIT_INDEX_H
+
+#include <stddef.h>
+
+struct Commit;
+
+/* -------- Commit lookup tables shared by CLI and GUI -------- */
+/* by_id:   open-addressing hash table, commit_id -> Commit (O(1))
+   by_hash: commits sorted by content hash, rebuilt lazily, for
+            abbreviated-hash lookups (O(log n)) */
+typedef struct CommitIndex {
+    struct Commit **by_id;
+    size_t id_cap;                // power of two
+    size_t count;
+
+    struct Commit **by_hash;
+    size_t by_hash_count;
+    int by_hash_dirty;
+} CommitIndex;
+
+void commit_index_insert(CommitIndex *idx, struct Commit *c);
+void commit_index_remove(CommitIndex *idx, int commit_id);
+struct Commit *commit_index_find(const CommitIndex *idx, int commit_id);
+
+/* Find the commit whose hex hash starts with prefix.
+   Returns NULL if none or several match (*ambiguous set to 1). */
+struct Commit *commit_index_find_prefix(CommitIndex *idx, const char *prefix, int *ambiguous);
+
+void commit_index_clear(CommitIndex *idx);
+
+#endif /* COMMIT_INDEX_H */
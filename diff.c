@@ -0,0 +1,538 @@
+#include "diff.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+
+#define BINARY_PROBE    8000          // NUL in the first bytes: binary file
+#define MAX_CHAIN       64            // histogram: ignore lines more common than this
+#define MAX_DEPTH       64            // histogram: recursion before falling back to Myers
+#define MIN_COST        256           // Myers: edit steps before settling for a split
+
+/* One side of the comparison, cut down to the lines that may differ */
+typedef struct DiffFile {
+    const unsigned char *data;    // window start (a line start)
+    size_t *start;                // line i is data[start[i] .. start[i + 1])
+    int *cls;                     // interned class of each line still in play
+    int *line_of;                 // cls[k] belongs to line line_of[k]
+    char *changed;                // per line: not part of the common subsequence
+    int n;                        // lines
+    int nk;                       // lines in play (have a match on the other side)
+} DiffFile;
+
+typedef struct DiffCtx {
+    DiffFile a, b;
+    int lead, trail;              // context lines around the window, equal by construction
+    int classes;
+    int *v1, *v2;                 // Myers: furthest x per diagonal
+    int max_cost;
+    int *cnt, *head, *nxt;        // histogram: occurrences in the current region
+} DiffCtx;
+
+/* =============== LINES =================== */
+
+static int split_lines(DiffFile *f, const unsigned char *data, size_t len) {
+    const unsigned char *p = data, *end = data + len;
+    size_t n = 0;
+    while (p < end) {
+        const unsigned char *nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl ? nl + 1 : end;
+        n++;
+    }
+    if (n >= INT32_MAX) return -1;
+
+    f->data = data;
+    f->n = (int)n;
+    f->start = malloc((n + 1) * sizeof(size_t));
+    f->cls = malloc((n + 1) * sizeof(int));
+    f->line_of = malloc((n + 1) * sizeof(int));
+    f->changed = calloc(n + 1, 1);
+    if (!f->start || !f->cls || !f->line_of || !f->changed) return -1;
+
+    p = data;
+    for (size_t i = 0; i < n; i++) {
+        f->start[i] = (size_t)(p - data);
+        const unsigned char *nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl ? nl + 1 : end;
+    }
+    f->start[n] = len;
+    return 0;
+}
+
+static uint64_t line_hash(const unsigned char *p, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull;              // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+/* Give equal lines on both sides the same small integer */
+static int intern_lines(DiffCtx *d) {
+    typedef struct LineClass {
+        uint64_t hash;
+        const unsigned char *p;
+        size_t len;
+    } LineClass;
+
+    size_t total = (size_t)d->a.n + (size_t)d->b.n;
+    size_t cap = 16;
+    while (cap < total * 2) cap *= 2;
+
+    int *table = calloc(cap, sizeof(int));               // class + 1, 0 = empty
+    LineClass *classes = malloc((total + 1) * sizeof(LineClass));
+    if (!table || !classes) {
+        free(table);
+        free(classes);
+        return -1;
+    }
+
+    DiffFile *sides[2] = { &d->a, &d->b };
+    d->classes = 0;
+    for (int s = 0; s < 2; s++) {
+        DiffFile *f = sides[s];
+        for (int i = 0; i < f->n; i++) {
+            const unsigned char *p = f->data + f->start[i];
+            size_t len = f->start[i + 1] - f->start[i];
+            uint64_t h = line_hash(p, len);
+
+            size_t slot = (size_t)h & (cap - 1);
+            for (;;) {
+                int c = table[slot];
+                if (c == 0) {
+                    classes[d->classes] = (LineClass){ h, p, len };
+                    table[slot] = ++d->classes;
+                    f->cls[i] = d->classes - 1;
+                    break;
+                }
+                LineClass *lc = &classes[c - 1];
+                if (lc->hash == h && lc->len == len && memcmp(lc->p, p, len) == 0) {
+                    f->cls[i] = c - 1;
+                    break;
+                }
+                slot = (slot + 1) & (cap - 1);
+            }
+        }
+    }
+
+    free(table);
+    free(classes);
+    return 0;
+}
+
+/* A line with no equal line on the other side can never be matched:
+   leave it out of the search (it stays changed), so the algorithms only
+   see lines that might pair up. The lead/trail context lines are left
+   out too; they are known to be equal. */
+static int discard_unmatched(DiffCtx *d) {
+    char *in_a = calloc((size_t)d->classes + 1, 1);
+    char *in_b = calloc((size_t)d->classes + 1, 1);
+    if (!in_a || !in_b) {
+        free(in_a);
+        free(in_b);
+        return -1;
+    }
+    for (int i = 0; i < d->a.n; i++) in_a[d->a.cls[i]] = 1;
+    for (int j = 0; j < d->b.n; j++) in_b[d->b.cls[j]] = 1;
+
+    DiffFile *sides[2] = { &d->a, &d->b };
+    const char *other[2] = { in_b, in_a };
+    for (int s = 0; s < 2; s++) {
+        DiffFile *f = sides[s];
+        f->nk = 0;
+        for (int i = d->lead; i < f->n - d->trail; i++) {
+            if (!other[s][f->cls[i]]) continue;
+            f->cls[f->nk] = f->cls[i];
+            f->line_of[f->nk++] = i;
+        }
+    }
+    free(in_a);
+    free(in_b);
+    return 0;
+}
+
+/* Spread the per-kept-line marks back over all lines */
+static void restore_unmatched(const DiffCtx *d, DiffFile *f) {
+    int k = f->nk - 1;
+    for (int i = f->n - 1; i >= 0; i--) {
+        if (i < d->lead || i >= f->n - d->trail) f->changed[i] = 0;
+        else if (k >= 0 && f->line_of[k] == i) f->changed[i] = f->changed[k--];
+        else f->changed[i] = 1;
+    }
+}
+
+static void mark_changed(DiffCtx *d, int a0, int a1, int b0, int b1) {
+    for (int i = a0; i < a1; i++) d->a.changed[i] = 1;
+    for (int j = b0; j < b1; j++) d->b.changed[j] = 1;
+}
+
+/* =============== MYERS (linear space) =================== */
+
+/* Walk forward from the top-left and backward from the bottom-right of
+   A[a0,a1) x B[b0,b1) until the two frontiers overlap; that point lies
+   on a shortest edit path and splits the problem in two. Past max_cost
+   steps the furthest forward point is used instead (not minimal, but
+   bounded). Returns -1 if the region has no common line at all. */
+static int middle_snake(DiffCtx *d, int a0, int a1, int b0, int b1, int *sx, int *sy) {
+    const int *A = d->a.cls + a0, *B = d->b.cls + b0;
+    int n = a1 - a0, m = b1 - b0;
+    int max_d = (n + m + 1) / 2;
+    int off = max_d + 1;
+    int vlen = 2 * max_d + 3;
+    int *v1 = d->v1, *v2 = d->v2;
+
+    for (int i = 0; i < vlen; i++) v1[i] = v2[i] = -1;
+    v1[off + 1] = 0;
+    v2[off + 1] = 0;
+
+    int delta = n - m;
+    int front = (delta % 2) != 0;         // odd: paths meet on a forward step
+    int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+    for (int dd = 0; dd < max_d; dd++) {
+        if (dd > d->max_cost) {
+            int best = -1;
+            for (int k = -dd + k1start; k <= dd - k1end; k += 2) {
+                int x = v1[off + k], y = x - k;
+                if (x >= 0 && x <= n && y >= 0 && y <= m && (best < 0 || x + y > *sx + *sy)) {
+                    *sx = x;
+                    *sy = y;
+                    best = k;
+                }
+            }
+            return best < 0 ? -1 : 0;
+        }
+
+        for (int k1 = -dd + k1start; k1 <= dd - k1end; k1 += 2) {
+            int k1_off = off + k1;
+            int x1 = (k1 == -dd || (k1 != dd && v1[k1_off - 1] < v1[k1_off + 1]))
+                   ? v1[k1_off + 1] : v1[k1_off - 1] + 1;
+            int y1 = x1 - k1;
+            while (x1 < n && y1 < m && A[x1] == B[y1]) {
+                x1++;
+                y1++;
+            }
+            v1[k1_off] = x1;
+            if (x1 > n) {
+                k1end += 2;
+            } else if (y1 > m) {
+                k1start += 2;
+            } else if (front) {
+                int k2_off = off + delta - k1;
+                if (k2_off >= 0 && k2_off < vlen && v2[k2_off] != -1 && x1 >= n - v2[k2_off]) {
+                    *sx = x1;
+                    *sy = y1;
+                    return 0;
+                }
+            }
+        }
+
+        for (int k2 = -dd + k2start; k2 <= dd - k2end; k2 += 2) {
+            int k2_off = off + k2;
+            int x2 = (k2 == -dd || (k2 != dd && v2[k2_off - 1] < v2[k2_off + 1]))
+                   ? v2[k2_off + 1] : v2[k2_off - 1] + 1;
+            int y2 = x2 - k2;
+            while (x2 < n && y2 < m && A[n - x2 - 1] == B[m - y2 - 1]) {
+                x2++;
+                y2++;
+            }
+            v2[k2_off] = x2;
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (!front) {
+                int k1_off = off + delta - k2;
+                if (k1_off >= 0 && k1_off < vlen && v1[k1_off] != -1) {
+                    int x1 = v1[k1_off];
+                    if (x1 >= n - x2) {
+                        *sx = x1;
+                        *sy = x1 - (k1_off - off);
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+static void diff_myers(DiffCtx *d, int a0, int a1, int b0, int b1) {
+    for (;;) {
+        const int *A = d->a.cls, *B = d->b.cls;
+        while (a0 < a1 && b0 < b1 && A[a0] == B[b0]) { a0++; b0++; }
+        while (a0 < a1 && b0 < b1 && A[a1 - 1] == B[b1 - 1]) { a1--; b1--; }
+        if (a0 == a1 || b0 == b1) {
+            mark_changed(d, a0, a1, b0, b1);
+            return;
+        }
+
+        int x, y;
+        if (middle_snake(d, a0, a1, b0, b1, &x, &y) != 0 ||
+            (x == 0 && y == 0) || (x == a1 - a0 && y == b1 - b0)) {
+            mark_changed(d, a0, a1, b0, b1);
+            return;
+        }
+
+        diff_myers(d, a0, a0 + x, b0, b0 + y);
+        a0 += x;
+        b0 += y;
+    }
+}
+
+/* =============== HISTOGRAM =================== */
+
+/* Split around the longest run of equal lines that contains the rarest
+   line of A[a0,a1) also found in B; recurse on both sides. */
+static void diff_histogram(DiffCtx *d, int a0, int a1, int b0, int b1, int depth) {
+    const int *A = d->a.cls, *B = d->b.cls;
+    int *cnt = d->cnt, *head = d->head, *nxt = d->nxt;
+
+    for (;;) {
+        while (a0 < a1 && b0 < b1 && A[a0] == B[b0]) { a0++; b0++; }
+        while (a0 < a1 && b0 < b1 && A[a1 - 1] == B[b1 - 1]) { a1--; b1--; }
+        if (a0 == a1 || b0 == b1) {
+            mark_changed(d, a0, a1, b0, b1);
+            return;
+        }
+        if (depth >= MAX_DEPTH) {
+            diff_myers(d, a0, a1, b0, b1);
+            return;
+        }
+
+        /* Occurrences of each line in A, chained in ascending order */
+        for (int i = a1 - 1; i >= a0; i--) {
+            int c = A[i];
+            nxt[i] = cnt[c] ? head[c] : -1;
+            head[c] = i;
+            cnt[c]++;
+        }
+
+        int best_cnt = MAX_CHAIN + 1, best_len = 0;
+        int s1 = 0, s2 = 0, e1 = 0;
+        int has_common = 0;
+
+        for (int j = b0; j < b1; ) {
+            int c = B[j], next_j = j + 1;
+            if (cnt[c] == 0) {
+                j = next_j;
+                continue;
+            }
+            has_common = 1;
+            if (cnt[c] > MAX_CHAIN || cnt[c] > best_cnt) {
+                j = next_j;
+                continue;
+            }
+
+            for (int i = head[c]; i != -1; i = nxt[i]) {
+                int as = i, bs = j, ae = i + 1, be = j + 1, rc = cnt[c];
+                while (as > a0 && bs > b0 && A[as - 1] == B[bs - 1]) {
+                    as--;
+                    bs--;
+                    if (cnt[A[as]] < rc) rc = cnt[A[as]];
+                }
+                while (ae < a1 && be < b1 && A[ae] == B[be]) {
+                    if (cnt[A[ae]] < rc) rc = cnt[A[ae]];
+                    ae++;
+                    be++;
+                }
+                if (be > next_j) next_j = be;
+                if (ae - as > best_len || rc < best_cnt) {
+                    s1 = as;
+                    s2 = bs;
+                    e1 = ae;
+                    best_len = ae - as;
+                    best_cnt = rc;
+                }
+            }
+            j = next_j;
+        }
+
+        for (int i = a0; i < a1; i++) cnt[A[i]] = 0;
+
+        if (best_len == 0) {
+            if (has_common) diff_myers(d, a0, a1, b0, b1);       // only very common lines
+            else mark_changed(d, a0, a1, b0, b1);
+            return;
+        }
+
+        int e2 = s2 + best_len;
+        diff_histogram(d, a0, s1, b0, s2, depth + 1);
+        a0 = e1;
+        b0 = e2;
+    }
+}
+
+/* =============== OUTPUT =================== */
+
+typedef struct Block {
+    int a0, a1, b0, b1;
+} Block;
+
+static void print_line(FILE *out, char tag, const DiffFile *f, int i) {
+    const unsigned char *p = f->data + f->start[i];
+    size_t len = f->start[i + 1] - f->start[i];
+    fputc(tag, out);
+    fwrite(p, 1, len, out);
+    if (len == 0 || p[len - 1] != '\n')
+        fputs("\n\\ No newline at end of file\n", out);
+}
+
+static int print_hunks(FILE *out, const DiffCtx *d, int base, DiffStats *stats,
+                       const char *a_name, const char *b_name) {
+    Block *blocks = NULL;
+    int count = 0, cap = 0;
+
+    for (int i = 0, j = 0; i < d->a.n || j < d->b.n; ) {
+        if ((i < d->a.n && d->a.changed[i]) || (j < d->b.n && d->b.changed[j])) {
+            if (count == cap) {
+                int ncap = cap ? cap * 2 : 16;
+                Block *nb = realloc(blocks, (size_t)ncap * sizeof(Block));
+                if (!nb) {
+                    free(blocks);
+                    return -1;
+                }
+                blocks = nb;
+                cap = ncap;
+            }
+            Block *bl = &blocks[count++];
+            bl->a0 = i;
+            bl->b0 = j;
+            while (i < d->a.n && d->a.changed[i]) i++;
+            while (j < d->b.n && d->b.changed[j]) j++;
+            bl->a1 = i;
+            bl->b1 = j;
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    if (count > 0)
+        fprintf(out, "--- %s\n+++ %s\n", a_name, b_name);
+
+    /* Unchanged lines pair up one to one, so context is the same on both sides */
+    for (int k = 0; k < count; ) {
+        int last = k;
+        while (last + 1 < count && blocks[last + 1].a0 - blocks[last].a1 <= 2 * DIFF_CONTEXT)
+            last++;
+
+        int lead = blocks[k].a0 < DIFF_CONTEXT ? blocks[k].a0 : DIFF_CONTEXT;
+        int tail = d->a.n - blocks[last].a1;
+        if (tail > DIFF_CONTEXT) tail = DIFF_CONTEXT;
+
+        int ha = blocks[k].a0 - lead, hb = blocks[k].b0 - lead;
+        int la = blocks[last].a1 + tail - ha, lb = blocks[last].b1 + tail - hb;
+        fprintf(out, "@@ -%d,%d +%d,%d @@\n",
+                base + ha + (la ? 1 : 0), la, base + hb + (lb ? 1 : 0), lb);
+
+        int i = ha;
+        for (int t = k; t <= last; t++) {
+            const Block *bl = &blocks[t];
+            for (; i < bl->a0; i++) print_line(out, ' ', &d->a, i);
+            for (int x = bl->a0; x < bl->a1; x++) print_line(out, '-', &d->a, x);
+            for (int y = bl->b0; y < bl->b1; y++) print_line(out, '+', &d->b, y);
+            i = bl->a1;
+            stats->removed += bl->a1 - bl->a0;
+            stats->added += bl->b1 - bl->b0;
+        }
+        for (; i < blocks[last].a1 + tail; i++) print_line(out, ' ', &d->a, i);
+
+        stats->hunks++;
+        k = last + 1;
+    }
+
+    free(blocks);
+    return 0;
+}
+
+/* =============== DRIVER =================== */
+
+static int at_line_start(const unsigned char *p, size_t pos, size_t floor) {
+    return pos == floor || p[pos - 1] == '\n';
+}
+
+int diff_print(FILE *out, const char *a_name, const DiffText *a,
+               const char *b_name, const DiffText *b,
+               DiffAlgorithm alg, DiffStats *stats) {
+    const unsigned char *pa = a->data ? a->data : (const unsigned char *)"";
+    const unsigned char *pb = b->data ? b->data : (const unsigned char *)"";
+    size_t la = a->size, lb = b->size;
+
+    if (la == lb && memcmp(pa, pb, la) == 0) return 0;
+
+    if (memchr(pa, '\0', la < BINARY_PROBE ? la : BINARY_PROBE) ||
+        memchr(pb, '\0', lb < BINARY_PROBE ? lb : BINARY_PROBE)) {
+        fprintf(out, "Binary files %s and %s differ\n", a_name, b_name);
+        stats->binary++;
+        return 0;
+    }
+
+    /* Skip the common head and tail byte-wise, keeping whole lines plus
+       DIFF_CONTEXT lines of context; only the rest is split and hashed. */
+    size_t lim = la < lb ? la : lb, cut = 0, tail = 0;
+    while (cut < lim && pa[cut] == pb[cut]) cut++;
+    while (cut > 0 && pa[cut - 1] != '\n') cut--;
+
+    lim -= cut;
+    while (tail < lim && pa[la - 1 - tail] == pb[lb - 1 - tail]) tail++;
+    while (tail > 0 && !(at_line_start(pa, la - tail, cut) && at_line_start(pb, lb - tail, cut)))
+        tail--;
+
+    int lead = 0, trail = 0;
+    for (; lead < DIFF_CONTEXT && cut > 0; lead++) {
+        cut--;
+        while (cut > 0 && pa[cut - 1] != '\n') cut--;
+    }
+    for (; trail < DIFF_CONTEXT && tail > 0; trail++) {
+        tail--;
+        while (tail > 0 && pa[la - tail - 1] != '\n') tail--;
+    }
+
+    int base = 0;
+    for (const unsigned char *p = pa; (p = memchr(p, '\n', (size_t)(pa + cut - p))); p++)
+        base++;
+
+    DiffCtx d;
+    memset(&d, 0, sizeof(d));
+    d.lead = lead;
+    d.trail = trail;
+    int rc = -1;
+
+    if (split_lines(&d.a, pa + cut, la - cut - tail) != 0 ||
+        split_lines(&d.b, pb + cut, lb - cut - tail) != 0 ||
+        intern_lines(&d) != 0 || discard_unmatched(&d) != 0)
+        goto done;
+
+    size_t vlen = (size_t)d.a.nk + (size_t)d.b.nk + 4;
+    d.v1 = malloc(vlen * sizeof(int));
+    d.v2 = malloc(vlen * sizeof(int));
+    if (!d.v1 || !d.v2) goto done;
+
+    d.max_cost = 1;
+    while ((size_t)d.max_cost * (size_t)d.max_cost < vlen) d.max_cost *= 2;
+    if (d.max_cost < MIN_COST) d.max_cost = MIN_COST;
+
+    if (alg == DIFF_HISTOGRAM) {
+        d.cnt = calloc((size_t)d.classes + 1, sizeof(int));
+        d.head = malloc(((size_t)d.classes + 1) * sizeof(int));
+        d.nxt = malloc(((size_t)d.a.nk + 1) * sizeof(int));
+        if (!d.cnt || !d.head || !d.nxt) goto done;
+        diff_histogram(&d, 0, d.a.nk, 0, d.b.nk, 0);
+    } else {
+        diff_myers(&d, 0, d.a.nk, 0, d.b.nk);
+    }
+    restore_unmatched(&d, &d.a);
+    restore_unmatched(&d, &d.b);
+
+    rc = print_hunks(out, &d, base, stats, a_name, b_name);
+
+done:
+    free(d.a.start); free(d.a.cls); free(d.a.line_of); free(d.a.changed);
+    free(d.b.start); free(d.b.cls); free(d.b.line_of); free(d.b.changed);
+    free(d.v1); free(d.v2);
+    free(d.cnt); free(d.head); free(d.nxt);
+    return rc;
+}
@@ -0,0 +1,47 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* -------- Line diff of two texts, printed as a unified diff -------- */
+/* Every line is hashed once and interned to a small integer, so the
+   algorithms below compare ints, never bytes. Common leading and
+   trailing lines are trimmed first, so the work done is proportional
+   to the changed region rather than to the file size.
+
+     DIFF_MYERS      shortest edit script, Myers' linear-space
+                     divide-and-conquer ("middle snake") variant
+     DIFF_HISTOGRAM  anchors on the rarest lines both sides share
+                     (patience diff extended as in git's histogram);
+                     keeps moved blocks and braces readable. Regions
+                     without a usable anchor fall back to Myers.
+*/
+typedef enum DiffAlgorithm {
+    DIFF_MYERS,
+    DIFF_HISTOGRAM
+} DiffAlgorithm;
+
+#define DIFF_CONTEXT 3                // unchanged lines shown around a change
+
+typedef struct DiffStats {
+    int added;
+    int removed;
+    int hunks;
+    int binary;                   // contents differ but were not compared
+} DiffStats;
+
+/* One side of a comparison: borrowed bytes (see span.h) */
+typedef struct DiffText {
+    const unsigned char *data;
+    size_t size;
+} DiffText;
+
+/* Print the diff of a against b under the names a_name / b_name
+   ("/dev/null" for a missing side). Prints nothing if the texts are
+   equal. Returns 0, or -1 if memory ran out. */
+int  diff_print(FILE *out, const char *a_name, const DiffText *a,
+                const char *b_name, const DiffText *b,
+                DiffAlgorithm alg, DiffStats *stats);
+
+#endif /* DIFF_H */
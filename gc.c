@@ -0,0 +1,191 @@
+#include "gc.h"
+#include "minigit.h"
+#include "pack.h"
+#include "repo_store.h"
+
+#include <string.h>
+
+typedef enum GcPhase {
+    GC_IDLE,
+    GC_MARK,
+    GC_SWEEP_LOOSE,
+    GC_SWEEP_PACK
+} GcPhase;
+
+static struct {
+    GcPhase phase;
+    unsigned epoch;               // stamped into Blob.reached
+    int next_commit_id;           // mark: resume at the first commit >= this id
+    int file_pos;                 //       and this file within it
+    int fanout;                   // sweep: next loose fan-out directory
+    uint32_t pack_pos;            // pack: next index entry to check
+    int pack_dead;                //       unreachable entries seen so far
+    GcReport report;
+} gc;
+
+/* Reached this cycle: by the mark, from the staging area when the cycle
+   started, or referenced since (see object_store_set_epoch) */
+static int is_live(const ObjectId *id, void *ctx) {
+    (void)ctx;
+    const Blob *b = object_store_get(id);
+    return b && b->reached == gc.epoch;
+}
+
+static void finish_cycle(int finished) {
+    gc.phase = GC_IDLE;
+    gc.report.finished = finished;
+    object_store_set_epoch(0);
+}
+
+/* First commit-graph row with commit_id >= id, or NULL */
+static const GraphRow *row_at_or_after(int id) {
+    const CommitGraph *g = &repo.graph;
+    int lo = 0, hi = g->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (g->rows[mid].commit_id < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < g->count ? &g->rows[lo] : NULL;
+}
+
+/* =============== PHASES =================== */
+
+static int mark_slice(int budget) {
+    int work = 0;
+    while (work < budget) {
+        const GraphRow *row = row_at_or_after(gc.next_commit_id);
+        if (!row) {
+            /* Fold the log into the table first: nothing is deleted
+               while a logged commit could still be replayed from it */
+            if (repo_store_checkpoint(&repo) != 0) {
+                finish_cycle(0);
+                break;
+            }
+            gc.phase = GC_SWEEP_LOOSE;
+            gc.fanout = 0;
+            break;
+        }
+
+        Commit *c = find_commit(row->commit_id);
+        for (; c && gc.file_pos < c->file_count && work < budget; gc.file_pos++, work++) {
+            Blob *b = c->files[gc.file_pos].blob;
+            if (b->reached == gc.epoch) continue;
+            b->reached = gc.epoch;
+            gc.report.live_blobs++;
+            gc.report.live_bytes += b->size;
+        }
+        if (c && gc.file_pos < c->file_count) break;      // budget spent mid-commit
+
+        gc.report.commits++;
+        gc.next_commit_id = row->commit_id + 1;
+        gc.file_pos = 0;
+        work++;
+    }
+    return work;
+}
+
+static int sweep_loose_slice(int budget) {
+    int work = 0;
+    while (work < budget && gc.fanout < OBJECT_FANOUT) {
+        SweepStats st = {0};
+        work += object_store_sweep_fanout(gc.fanout++, is_live, NULL, &st) + 1;
+        gc.report.loose_removed += st.removed;
+        gc.report.loose_bytes += st.bytes;
+    }
+
+    if (gc.fanout >= OBJECT_FANOUT) {
+        SweepStats st = {0};
+        object_store_sweep_temp(&st);
+        gc.report.temp_removed += st.removed;
+        gc.report.loose_bytes += st.bytes;
+
+        gc.phase = GC_SWEEP_PACK;
+        gc.pack_pos = 0;
+    }
+    return work;
+}
+
+static int sweep_pack_slice(int budget) {
+    int work = 0;
+    uint32_t count = pack_object_count();
+    for (; gc.pack_pos < count && work < budget; gc.pack_pos++, work++) {
+        ObjectId id;
+        if (pack_object_id(gc.pack_pos, &id) == 0 && !is_live(&id, NULL))
+            gc.pack_dead++;
+    }
+    if (gc.pack_pos < count) return work;
+
+    if (gc.pack_dead > 0) {
+        size_t before = pack_file_size();
+        PackStats ps = {0};
+        if (repack_objects(1, &ps) == 0) {
+            gc.report.pack_dead += gc.pack_dead;
+            if (ps.pack_bytes < before) gc.report.pack_bytes += before - ps.pack_bytes;
+        }
+    }
+
+    finish_cycle(1);
+    return work;
+}
+
+/* =============== DRIVER =================== */
+
+void gc_start(void) {
+    if (gc.phase != GC_IDLE) return;
+
+    unsigned epoch = gc.epoch + 1;
+    if (epoch == 0) epoch = 1;                   // 0 is "never reached"
+    GcReport prev = gc.report;
+
+    memset(&gc, 0, sizeof(gc));
+    gc.epoch = epoch;
+    gc.phase = GC_MARK;
+    object_store_set_epoch(epoch);
+    mark_staged_blobs(epoch);
+
+    if (!prev.reported) {
+        GcReport *r = &gc.report;
+        r->loose_removed = prev.loose_removed;
+        r->temp_removed = prev.temp_removed;
+        r->loose_bytes = prev.loose_bytes;
+        r->pack_dead = prev.pack_dead;
+        r->pack_bytes = prev.pack_bytes;
+        r->steps = prev.steps;
+        r->cycles = prev.cycles;
+    }
+    gc.report.cycles++;
+}
+
+int gc_step(int budget) {
+    if (gc.phase == GC_IDLE) return 0;
+    if (budget < 1) budget = 1;
+
+    gc.report.steps++;
+    int work = 0;
+    while (gc.phase != GC_IDLE && work < budget) {
+        switch (gc.phase) {
+        case GC_MARK:        work += mark_slice(budget - work); break;
+        case GC_SWEEP_LOOSE: work += sweep_loose_slice(budget - work); break;
+        case GC_SWEEP_PACK:  work += sweep_pack_slice(budget - work); break;
+        case GC_IDLE:        break;
+        }
+    }
+    return gc.phase != GC_IDLE;
+}
+
+int gc_active(void) {
+    return gc.phase != GC_IDLE;
+}
+
+void gc_cancel(void) {
+    finish_cycle(0);
+}
+
+const GcReport *gc_last_report(void) {
+    return &gc.report;
+}
+
+void gc_ack_report(void) {
+    gc.report.reported = 1;
+}
@@ -0,0 +1,53 @@
+#ifndef GC_H
+#define GC_H
+
+#include <stddef.h>
+
+/* -------- Mark-and-sweep garbage collection of the object store -------- */
+/* Deleting a commit only drops references; the loose files and pack
+ * entries behind them stay on disk. A GC cycle reclaims them:
+ *
+ *   mark   walk every commit (oldest first) and stamp the blobs it
+ *          reaches with the cycle number, then checkpoint the log
+ *          into the commit table so no logged commit refers to a blob
+ *          the sweep removes
+ *   sweep  delete loose objects that were not reached, and abandoned
+ *          temp files
+ *   pack   count unreachable pack entries; if there are any, rewrite
+ *          the pack with the reachable ones only
+ *
+ * The cycle advances in slices of at most `budget` units of work (one
+ * unit per commit file marked or directory entry examined), so callers
+ * can interleave it with interactive use. Staged blobs are stamped when
+ * the cycle starts and blobs stored or referenced while it runs as that
+ * happens, so commits made mid-cycle are safe. The pack rewrite is the
+ * one step whose cost is not bounded by the budget.
+ */
+#define GC_STEP_BUDGET 2048
+
+/* The mark counts describe the latest cycle; the reclaim counts add up
+   over every cycle since the report was last acknowledged, so cycles
+   run in the background are not lost. */
+typedef struct GcReport {
+    int commits;                  // commits walked by the mark phase
+    int live_blobs;               // distinct blobs reached
+    size_t live_bytes;
+    int loose_removed;            // unreachable loose objects deleted
+    int temp_removed;             // abandoned temp files deleted
+    size_t loose_bytes;           // bytes freed by both
+    int pack_dead;                // unreachable objects dropped from the pack
+    size_t pack_bytes;            // bytes the pack shrank by
+    int steps;                    // slices taken
+    int cycles;
+    int finished;                 // the latest cycle ran to the end
+    int reported;                 // acknowledged since
+} GcReport;
+
+void gc_start(void);                          // no-op if a cycle is running
+int  gc_step(int budget);                     // 1 while the cycle is unfinished
+int  gc_active(void);
+void gc_cancel(void);                         // the repository is being reloaded
+const GcReport *gc_last_report(void);
+void gc_ack_report(void);                     // shown to the user; start counting afresh
+
+#endif /* GC_H */
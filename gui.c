@@ -15,10 +15,13 @@
 #include <string.h>
 
 #include "minigit.h"
+#include "gc.h"
 #include "trie_index.h"
 #include "search_engine.h"
 #include "autocomplete.h"
 #include "ranking.h"
+#include "repo_store.h"
+#include "span.h"
 
 #define WORKING_DIR ".mgit_work"   /* must match minigit.c */
 
@@ -37,6 +40,7 @@ GtkWidget *git_commit_entry;         /* commit staged files */
 GtkWidget *git_commit_id_entry;      /* view/delete/checkout */
 GtkWidget *git_save_commit_entry;    /* commit from working dir */
 GtkWidget *commit_files_list;        /* list of files in checked-out commit */
+GtkWidget *commit_log_view;          /* GtkListView over the lazy log model */
 
 /* Editor tab */
 GtkWidget *editor_notebook;          /* multiple file tabs */
@@ -57,25 +61,6 @@ static void append_text_view_text(GtkWidget *text_view, const char *text) {
 
 /* ---------------- Helper: File I/O + editor helpers ---------------- */
 
-static char *read_file_to_string(const char *path) {
-    FILE *fp = fopen(path, "r");
-    if (!fp) return NULL;
-
-    fseek(fp, 0, SEEK_END);
-    long sz = ftell(fp);
-    rewind(fp);
-
-    if (sz < 0) { fclose(fp); return NULL; }
-
-    char *buf = (char *)malloc((size_t)sz + 1);
-    if (!buf) { fclose(fp); return NULL; }
-
-    size_t n = fread(buf, 1, (size_t)sz, fp);
-    buf[n] = '\0';
-    fclose(fp);
-    return buf;
-}
-
 static gboolean save_textview_to_file(GtkTextView *tv, const char *path) {
     GtkTextBuffer *buffer = gtk_text_view_get_buffer(tv);
     GtkTextIter start, end;
@@ -209,28 +194,102 @@ static void on_search_button_clicked(GtkButton *button, gpointer user_data) {
     g_string_free(output, TRUE);
 }
 
-/* ---------------- Mini-Git Callbacks ---------------- */
+/* ---------------- Commit log: lazy list model ---------------- */
+/* Rows are formatted only when the list view asks for them (visible
+   rows plus a little overscan), so a 100k-commit history costs a few
+   dozen strings, not one giant text buffer. */
 
-static void refresh_commit_log_to_textview(void) {
-    Commit *temp = repo.head;
-    if (!temp) {
-        set_text_view_text(git_output_view, "No commits yet.\n");
-        return;
-    }
+#define MGIT_TYPE_LOG_MODEL (mgit_log_model_get_type())
+G_DECLARE_FINAL_TYPE(MgitLogModel, mgit_log_model, MGIT, LOG_MODEL, GObject)
 
-    GString *output = g_string_new("Commit Log:\n");
-    while (temp) {
-        g_string_append_printf(output, "Commit %d: %s\n", temp->commit_id, temp->message);
-        temp = temp->next;
-    }
+struct _MgitLogModel {
+    GObject parent_instance;
+    guint n_items;                   /* log_count() at the last refresh */
+};
 
-    set_text_view_text(git_output_view, output->str);
-    g_string_free(output, TRUE);
+static GType mgit_log_model_get_item_type(GListModel *list) {
+    (void)list;
+    return GTK_TYPE_STRING_OBJECT;
+}
+
+static guint mgit_log_model_get_n_items(GListModel *list) {
+    return MGIT_LOG_MODEL(list)->n_items;
+}
+
+static gpointer mgit_log_model_get_item(GListModel *list, guint position) {
+    MgitLogModel *self = MGIT_LOG_MODEL(list);
+    LogEntry e;
+    if (position >= self->n_items || log_entry_at((int)position, &e) != 0)
+        return NULL;
+
+    char hex[OBJECT_ID_HEXSZ + 1];
+    object_id_to_hex(&e.hash, hex);
+    char *line = g_strdup_printf("Commit %d [%.7s]: %s", e.commit_id, hex, e.message);
+    GtkStringObject *item = gtk_string_object_new(line);
+    g_free(line);
+    return item;
+}
+
+static void mgit_log_model_list_model_init(GListModelInterface *iface) {
+    iface->get_item_type = mgit_log_model_get_item_type;
+    iface->get_n_items = mgit_log_model_get_n_items;
+    iface->get_item = mgit_log_model_get_item;
+}
+
+G_DEFINE_TYPE_WITH_CODE(MgitLogModel, mgit_log_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, mgit_log_model_list_model_init))
+
+static void mgit_log_model_class_init(MgitLogModelClass *klass) {
+    (void)klass;
+}
+
+static void mgit_log_model_init(MgitLogModel *self) {
+    self->n_items = 0;
+}
+
+static MgitLogModel *log_model;      /* owned by commit_log_view's selection */
+
+static void log_item_setup(GtkSignalListItemFactory *factory, GtkListItem *item, gpointer user_data) {
+    (void)factory; (void)user_data;
+    GtkWidget *label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(label), 0.0f);
+    gtk_widget_add_css_class(label, "monospace");
+    gtk_list_item_set_child(item, label);
+}
+
+static void log_item_bind(GtkSignalListItemFactory *factory, GtkListItem *item, gpointer user_data) {
+    (void)factory; (void)user_data;
+    GtkWidget *label = gtk_list_item_get_child(item);
+    GtkStringObject *obj = GTK_STRING_OBJECT(gtk_list_item_get_item(item));
+    gtk_label_set_text(GTK_LABEL(label), gtk_string_object_get_string(obj));
+}
+
+/* Double-click / Enter on a log row: use it for View/Delete/Checkout */
+static void on_log_row_activated(GtkListView *view, guint position, gpointer user_data) {
+    (void)view; (void)user_data;
+    LogEntry e;
+    if (log_entry_at((int)position, &e) != 0) return;
+
+    char id[16];
+    snprintf(id, sizeof(id), "%d", e.commit_id);
+    gtk_editable_set_text(GTK_EDITABLE(git_commit_id_entry), id);
+}
+
+/* ---------------- Mini-Git Callbacks ---------------- */
+
+static void refresh_commit_log(void) {
+    guint old = log_model->n_items;
+    log_model->n_items = (guint)log_count();
+    g_list_model_items_changed(G_LIST_MODEL(log_model), 0, old, log_model->n_items);
+
+    if (log_model->n_items == 0)
+        set_text_view_text(git_output_view, "No commits yet.\n");
 }
 
 static void on_init_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button; (void)user_data;
     init_repository();
+    refresh_commit_log();
     set_text_view_text(git_output_view, "Repository has been initialized.\n");
 }
 
@@ -266,6 +325,7 @@ static void on_commit_button_clicked(GtkButton *button, gpointer user_data) {
     commit_staged(message_copy);
     g_free(message_copy);
 
+    refresh_commit_log();
     set_text_view_text(git_output_view, "Commit created from staged files.\n(See console for details.)\n");
     gtk_editable_set_text(GTK_EDITABLE(git_commit_entry), "");
 }
@@ -273,39 +333,40 @@ static void on_commit_button_clicked(GtkButton *button, gpointer user_data) {
 /* View log */
 static void on_log_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button; (void)user_data;
-    refresh_commit_log_to_textview();
+    refresh_commit_log();
 }
 
 /* View commit details (message only) */
 static void on_view_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button; (void)user_data;
     const char *id_str = gtk_editable_get_text(GTK_EDITABLE(git_commit_id_entry));
-    int cid = atoi(id_str);
+    int cid = resolve_commit_ref(id_str);
 
     if (cid <= 0) {
         set_text_view_text(git_output_view, "Error: Please enter a valid commit ID.\n");
         return;
     }
 
-    Commit *temp = repo.head;
-    while (temp) {
-        if (temp->commit_id == cid) {
-            char output[512];
-            snprintf(output, sizeof(output),
-                     "Details for Commit %d:\n%s\n", temp->commit_id, temp->message);
-            set_text_view_text(git_output_view, output);
-            return;
-        }
-        temp = temp->next;
+    Commit *temp = find_commit(cid);
+    if (!temp) {
+        set_text_view_text(git_output_view, "Commit not found.\n");
+        return;
     }
-    set_text_view_text(git_output_view, "Commit not found.\n");
+
+    char hex[OBJECT_ID_HEXSZ + 1];
+    object_id_to_hex(&temp->hash, hex);
+
+    char *output = g_strdup_printf("Details for Commit %d (%s):\n%s\n",
+                                   temp->commit_id, hex, temp->message);
+    set_text_view_text(git_output_view, output);
+    g_free(output);
 }
 
 /* Delete commit */
 static void on_delete_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button; (void)user_data;
     const char *id_str = gtk_editable_get_text(GTK_EDITABLE(git_commit_id_entry));
-    int cid = atoi(id_str);
+    int cid = resolve_commit_ref(id_str);
 
     if (cid <= 0) {
         set_text_view_text(git_output_view, "Error: Please enter a valid commit ID.\n");
@@ -313,28 +374,74 @@ static void on_delete_button_clicked(GtkButton *button, gpointer user_data) {
     }
 
     delete_commit(cid);
-    refresh_commit_log_to_textview();
+    refresh_commit_log();
     append_text_view_text(git_output_view, "\n(Attempted to delete commit. See console for details.)\n");
 }
 
+/* ---------------- Garbage collection ---------------- */
+/* A cycle runs in GC_STEP_BUDGET slices from a timer, so the window
+   keeps responding while a large store is swept. Deleting a commit
+   starts one too (in delete_commit); only the button reports. */
+
+#define GC_TICK_MS 20
+#define WAL_TICK_MS 20
+
+static gboolean gc_report_pending = FALSE;
+
+static void show_gc_report(void) {
+    const GcReport *r = gc_last_report();
+    char output[512];
+    snprintf(output, sizeof(output),
+             "Garbage collection finished (%d cycles, %d steps).\n"
+             "Reachable: %d blobs (%zu bytes) from %d commits.\n"
+             "Removed %d loose objects, %d temp files, %d packed objects.\n"
+             "Reclaimed %zu bytes.\n",
+             r->cycles, r->steps, r->live_blobs, r->live_bytes, r->commits,
+             r->loose_removed, r->temp_removed, r->pack_dead,
+             r->loose_bytes + r->pack_bytes);
+    set_text_view_text(git_output_view, output);
+}
+
+static gboolean on_gc_tick(gpointer user_data) {
+    (void)user_data;
+    if (gc_active() && !gc_step(GC_STEP_BUDGET) && gc_report_pending) {
+        gc_report_pending = FALSE;
+        show_gc_report();
+        gc_ack_report();
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* Sync logged changes once their group commit window has expired,
+   rather than on the next change */
+static gboolean on_wal_tick(gpointer user_data) {
+    (void)user_data;
+    if (repo_store_sync_due() != 0)
+        set_text_view_text(git_output_view, "Warning: could not sync the repository log.\n");
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_gc_button_clicked(GtkButton *button, gpointer user_data) {
+    (void)button; (void)user_data;
+    gc_start();
+    gc_report_pending = TRUE;
+    set_text_view_text(git_output_view, "Collecting garbage...\n");
+}
+
 /* After checkout, fill commit_files_list with filenames from that commit */
 static void fill_commit_files_list_for_commit(int cid) {
     /* GTK4: simply clear all rows */
     gtk_list_box_remove_all(GTK_LIST_BOX(commit_files_list));
 
-    Commit *temp = repo.head;
-    while (temp) {
-        if (temp->commit_id == cid) {
-            for (int i = 0; i < temp->file_count; i++) {
-                GtkWidget *row   = gtk_list_box_row_new();
-                GtkWidget *label = gtk_label_new(temp->files[i].filename);
-                gtk_widget_set_halign(label, GTK_ALIGN_START);
-                gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), label);
-                gtk_list_box_append(GTK_LIST_BOX(commit_files_list), row);
-            }
-            return;
-        }
-        temp = temp->next;
+    Commit *temp = find_commit(cid);
+    if (!temp) return;
+
+    for (int i = 0; i < temp->file_count; i++) {
+        GtkWidget *row   = gtk_list_box_row_new();
+        GtkWidget *label = gtk_label_new(temp->files[i].filename);
+        gtk_widget_set_halign(label, GTK_ALIGN_START);
+        gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), label);
+        gtk_list_box_append(GTK_LIST_BOX(commit_files_list), row);
     }
 }
 
@@ -342,7 +449,7 @@ static void fill_commit_files_list_for_commit(int cid) {
 static void on_checkout_button_clicked(GtkButton *button, gpointer user_data) {
     (void)button; (void)user_data;
     const char *id_str = gtk_editable_get_text(GTK_EDITABLE(git_commit_id_entry));
-    int cid = atoi(id_str);
+    int cid = resolve_commit_ref(id_str);
 
     if (cid <= 0) {
         set_text_view_text(git_output_view, "Error: Please enter a valid commit ID for checkout.\n");
@@ -350,13 +457,7 @@ static void on_checkout_button_clicked(GtkButton *button, gpointer user_data) {
     }
 
     /* Check if commit exists */
-    Commit *temp = repo.head;
-    int found = 0;
-    while (temp) {
-        if (temp->commit_id == cid) { found = 1; break; }
-        temp = temp->next;
-    }
-    if (!found) {
+    if (!find_commit(cid)) {
         set_text_view_text(git_output_view, "Commit not found. Cannot checkout.\n");
         return;
     }
@@ -403,8 +504,8 @@ static void on_open_in_editor_clicked(GtkButton *button, gpointer user_data) {
     char path[512];
     snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, filename);
 
-    char *contents = read_file_to_string(path);
-    if (!contents) {
+    Span contents;
+    if (span_open_file(path, &contents) != 0) {
         set_text_view_text(git_output_view, "Could not open file from .mgit_work/.\n");
         return;
     }
@@ -419,9 +520,10 @@ static void on_open_in_editor_clicked(GtkButton *button, gpointer user_data) {
 
     gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), textview);
 
-    /* Set file content */
-    set_text_view_text(textview, contents);
-    g_free(contents);
+    /* Set file content straight from the mapping; the buffer keeps its own copy */
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview));
+    gtk_text_buffer_set_text(buffer, (const char *)contents.data, (int)contents.size);
+    span_close(&contents);
 
     /* Store filepath in widget data, so we can save later */
     g_object_set_data_full(G_OBJECT(textview), "filepath", g_strdup(path), g_free);
@@ -528,8 +630,13 @@ static GtkWidget* create_minigit_tab(void) {
     GtkWidget *log_button = gtk_button_new_with_label("View Log");
     g_signal_connect(log_button, "clicked", G_CALLBACK(on_log_button_clicked), NULL);
 
+    GtkWidget *gc_button = gtk_button_new_with_label("Collect Garbage");
+    g_signal_connect(gc_button, "clicked", G_CALLBACK(on_gc_button_clicked), NULL);
+    g_timeout_add(GC_TICK_MS, on_gc_tick, NULL);
+    g_timeout_add(WAL_TICK_MS, on_wal_tick, NULL);
+
     git_filename_entry = gtk_entry_new();
-    gtk_entry_set_placeholder_text(GTK_ENTRY(git_filename_entry), "filename (absolute or relative)");
+    gtk_entry_set_placeholder_text(GTK_ENTRY(git_filename_entry), "file or directory (absolute or relative)");
     GtkWidget *add_button = gtk_button_new_with_label("Add File");
     g_signal_connect(add_button, "clicked", G_CALLBACK(on_add_button_clicked), NULL);
 
@@ -539,7 +646,7 @@ static GtkWidget* create_minigit_tab(void) {
     g_signal_connect(commit_button, "clicked", G_CALLBACK(on_commit_button_clicked), NULL);
 
     git_commit_id_entry = gtk_entry_new();
-    gtk_entry_set_placeholder_text(GTK_ENTRY(git_commit_id_entry), "Commit ID");
+    gtk_entry_set_placeholder_text(GTK_ENTRY(git_commit_id_entry), "Commit ID or hash");
 
     GtkWidget *view_button = gtk_button_new_with_label("View");
     g_signal_connect(view_button, "clicked", G_CALLBACK(on_view_button_clicked), NULL);
@@ -563,6 +670,21 @@ static GtkWidget* create_minigit_tab(void) {
     GtkWidget *open_editor_button = gtk_button_new_with_label("Open Selected File in Editor");
     g_signal_connect(open_editor_button, "clicked", G_CALLBACK(on_open_in_editor_clicked), NULL);
 
+    log_model = g_object_new(MGIT_TYPE_LOG_MODEL, NULL);
+    log_model->n_items = (guint)log_count();
+    GtkListItemFactory *log_factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(log_factory, "setup", G_CALLBACK(log_item_setup), NULL);
+    g_signal_connect(log_factory, "bind", G_CALLBACK(log_item_bind), NULL);
+
+    GtkSelectionModel *log_selection =
+        GTK_SELECTION_MODEL(gtk_single_selection_new(G_LIST_MODEL(log_model)));
+    commit_log_view = gtk_list_view_new(log_selection, log_factory);
+    g_signal_connect(commit_log_view, "activate", G_CALLBACK(on_log_row_activated), NULL);
+
+    GtkWidget *log_scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(log_scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(log_scrolled), commit_log_view);
+
     GtkWidget *output_scrolled_win = gtk_scrolled_window_new();
     gtk_widget_set_vexpand(output_scrolled_win, TRUE);
     git_output_view = gtk_text_view_new();
@@ -572,6 +694,7 @@ static GtkWidget* create_minigit_tab(void) {
 
     gtk_grid_attach(GTK_GRID(grid), init_button, 0, 0, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), log_button,  1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gc_button,   2, 0, 1, 1);
 
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("File:"),          0, 1, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), git_filename_entry,              1, 1, 2, 1);
@@ -598,9 +721,12 @@ static GtkWidget* create_minigit_tab(void) {
     gtk_grid_attach(GTK_GRID(grid), files_scrolled,                               0, 6, 4, 1);
     gtk_grid_attach(GTK_GRID(grid), open_editor_button,                           0, 7, 4, 1);
 
-    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Output/Log:"), 0, 8, 4, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Output:"),     0, 8, 4, 1);
     gtk_grid_attach(GTK_GRID(grid), output_scrolled_win,          0, 9, 4, 1);
 
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Commit Log:"), 0, 10, 4, 1);
+    gtk_grid_attach(GTK_GRID(grid), log_scrolled,                 0, 11, 4, 1);
+
     return grid;
 }
 
@@ -669,6 +795,7 @@ int main(int argc, char *argv[]) {
     g_object_unref(app);
 
     printf("Cleaning up backend systems...\n");
+    close_repository();
     cleanup_ranking_system();
     cleanup_autocomplete_system();
     cleanup_search_engine();
@@ -0,0 +1,344 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ignore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fnmatch.h>
+
+#define INITIAL_SLOTS 16
+
+static uint64_t hash_bytes(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ull;          // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/* =============== LITERAL TABLES =================== */
+
+static int table_grow(IgnoreTable *t) {
+    size_t count = t->slot_count ? t->slot_count * 2 : INITIAL_SLOTS;
+    IgnoreKey *slots = calloc(count, sizeof(IgnoreKey));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < t->slot_count; i++) {
+        const IgnoreKey *k = &t->slots[i];
+        if (!k->text) continue;
+        size_t j = (size_t)k->hash & (count - 1);
+        while (slots[j].text) j = (j + 1) & (count - 1);
+        slots[j] = *k;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->slot_count = count;
+    return 0;
+}
+
+/* Keys may repeat (one pattern written twice, or once with '!'): each
+   keeps its own slot and lookups see them all */
+static int table_add(IgnoreTable *t, const char *text, size_t len, int rule) {
+    if ((size_t)(t->count + 1) * 2 > t->slot_count && table_grow(t) != 0) return -1;
+
+    int known = 0;
+    for (int i = 0; i < t->len_count; i++)
+        if (t->lens[i] == len) known = 1;
+    if (!known) {
+        size_t *lens = realloc(t->lens, (size_t)(t->len_count + 1) * sizeof(size_t));
+        if (!lens) return -1;
+        t->lens = lens;
+        t->lens[t->len_count++] = len;
+    }
+
+    uint64_t hash = hash_bytes(text, len);
+    size_t i = (size_t)hash & (t->slot_count - 1);
+    while (t->slots[i].text) i = (i + 1) & (t->slot_count - 1);
+    t->slots[i] = (IgnoreKey){ text, len, hash, rule };
+    t->count++;
+    return 0;
+}
+
+/* Highest rule above best whose key is s[0, len) and that applies */
+static int table_find(const IgnoreRules *r, const IgnoreTable *t, const char *s,
+                      size_t len, int is_dir, int best) {
+    if (!t->count) return best;
+    uint64_t hash = hash_bytes(s, len);
+    size_t mask = t->slot_count - 1;
+    for (size_t i = (size_t)hash & mask; t->slots[i].text; i = (i + 1) & mask) {
+        const IgnoreKey *k = &t->slots[i];
+        if (k->rule <= best || k->hash != hash || k->len != len ||
+            memcmp(k->text, s, len) != 0)
+            continue;
+        if (r->rules[k->rule].dir_only && !is_dir) continue;
+        best = k->rule;
+    }
+    return best;
+}
+
+static void table_free(IgnoreTable *t) {
+    free(t->slots);
+    free(t->lens);
+    memset(t, 0, sizeof(*t));
+}
+
+/* =============== GLOB AUTOMATA =================== */
+
+/* Position p moves on every byte in set (or every byte but '/') */
+static void glob_step_all(IgnoreGlob *g, int p, int cross_slash) {
+    for (int c = 0; c < 256; c++)
+        if (cross_slash || c != '/') g->step[c] |= 1ull << p;
+}
+
+/* Parse the class starting at pat ('['); returns its length, 0 if it
+   is not terminated (the '[' is then an ordinary character) */
+static size_t glob_class(IgnoreGlob *g, int p, const char *pat) {
+    size_t i = 1;
+    int negate = pat[i] == '!' || pat[i] == '^';
+    if (negate) i++;
+
+    unsigned char set[256] = {0};
+    int first = 1;
+    while (pat[i] && (pat[i] != ']' || first)) {
+        first = 0;
+        unsigned char lo = (unsigned char)pat[i];
+        if (lo == '\\' && pat[i + 1]) lo = (unsigned char)pat[++i];
+        unsigned char hi = lo;
+        if (pat[i + 1] == '-' && pat[i + 2] && pat[i + 2] != ']') {
+            hi = (unsigned char)pat[i + 2];
+            i += 2;
+        }
+        for (int c = lo; c <= hi; c++) set[c] = 1;
+        i++;
+    }
+    if (pat[i] != ']') return 0;
+
+    for (int c = 0; c < 256; c++)
+        if (c != '/' && set[c] != negate) g->step[c] |= 1ull << p;
+    return i + 1;
+}
+
+/* Compile pat into g: one position per character to consume, stars
+   looping in place. Returns -1 if it needs more than IGNORE_GLOB_MAX. */
+static int glob_compile(IgnoreGlob *g, const char *pat) {
+    int p = 0;
+    size_t i = 0;
+
+    while (pat[i]) {
+        if (p + 3 > IGNORE_GLOB_MAX) return -1;
+        int seg_start = i == 0 || pat[i - 1] == '/';
+
+        if (seg_start && pat[i] == '*' && pat[i + 1] == '*' &&
+            (pat[i + 2] == '/' || !pat[i + 2])) {
+            if (pat[i + 2] == '/') {
+                /* "**" + "/": zero directories jumps over both */
+                g->skip1 |= 1ull << p;
+                g->skip3 |= 1ull << p;
+                p++;
+                for (int c = 0; c < 256; c++) g->loop[c] |= 1ull << p;
+                g->skip1 |= 1ull << p;
+                p++;
+                g->step['/'] |= 1ull << p;
+                p++;
+                i += 3;
+            } else {
+                for (int c = 0; c < 256; c++) g->loop[c] |= 1ull << p;
+                g->skip1 |= 1ull << p;
+                p++;
+                i += 2;
+            }
+            continue;
+        }
+
+        switch (pat[i]) {
+        case '*':
+            while (pat[i] == '*') i++;
+            for (int c = 0; c < 256; c++)
+                if (c != '/') g->loop[c] |= 1ull << p;
+            g->skip1 |= 1ull << p;
+            p++;
+            continue;
+        case '?':
+            glob_step_all(g, p++, 0);
+            i++;
+            continue;
+        case '[': {
+            size_t n = glob_class(g, p, pat + i);
+            if (n) {
+                p++;
+                i += n;
+                continue;
+            }
+            break;
+        }
+        case '\\':
+            if (pat[i + 1]) i++;
+            break;
+        }
+        g->step[(unsigned char)pat[i]] |= 1ull << p;
+        p++;
+        i++;
+    }
+    g->accept = p;
+    return 0;
+}
+
+static uint64_t glob_closure(const IgnoreGlob *g, uint64_t s) {
+    for (;;) {
+        uint64_t t = s | ((s & g->skip1) << 1) | ((s & g->skip3) << 3);
+        if (t == s) return s;
+        s = t;
+    }
+}
+
+static int glob_run(const IgnoreGlob *g, const char *s) {
+    if (g->long_pattern)
+        return fnmatch(g->long_pattern, s, FNM_PATHNAME) == 0;
+
+    uint64_t state = glob_closure(g, 1);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        state = ((state & g->step[*p]) << 1) | (state & g->loop[*p]);
+        if (!state) return 0;
+        state = glob_closure(g, state);
+    }
+    return (int)((state >> g->accept) & 1);
+}
+
+static int add_glob(IgnoreRules *r, const char *pat, int anchored, int rule) {
+    if (r->glob_count == r->glob_cap) {
+        int cap = r->glob_cap ? r->glob_cap * 2 : 8;
+        IgnoreGlob *p = realloc(r->globs, (size_t)cap * sizeof(IgnoreGlob));
+        if (!p) return -1;
+        r->globs = p;
+        r->glob_cap = cap;
+    }
+    IgnoreGlob *g = &r->globs[r->glob_count++];
+    memset(g, 0, sizeof(*g));
+    g->rule = rule;
+    g->anchored = anchored;
+    if (glob_compile(g, pat) != 0) {
+        memset(g, 0, sizeof(*g));
+        g->rule = rule;
+        g->anchored = anchored;
+        g->long_pattern = pat;
+    }
+    return 0;
+}
+
+/* =============== LOADING =================== */
+
+/* File the pattern under the cheapest matcher that is exact for it */
+static int compile_rule(IgnoreRules *r, int rule, int anchored) {
+    const char *pat = r->rules[rule].pattern;
+    size_t len = strlen(pat);
+    size_t meta = strcspn(pat, "*?[\\");
+
+    if (meta == len)
+        return table_add(anchored ? &r->paths : &r->names, pat, len, rule);
+    if (!anchored && pat[0] == '*' && strcspn(pat + 1, "*?[\\") == len - 1)
+        return table_add(&r->suffixes, pat + 1, len - 1, rule);
+    if (!anchored && meta == len - 1 && pat[meta] == '*')
+        return table_add(&r->prefixes, pat, len - 1, rule);
+    return add_glob(r, pat, anchored, rule);
+}
+
+static int add_rule(IgnoreRules *r, char *line) {
+    size_t len = strlen(line);
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+                   line[len - 1] == ' ' || line[len - 1] == '\t'))
+        line[--len] = '\0';
+    if (len == 0 || line[0] == '#') return 0;
+
+    IgnoreRule rule = {0};
+    if (line[0] == '!') {
+        rule.negate = 1;
+        line++;
+        len--;
+    }
+    if (len && line[len - 1] == '/') {
+        rule.dir_only = 1;
+        line[--len] = '\0';
+    }
+    int anchored = strchr(line, '/') != NULL;
+    while (*line == '/') line++;
+    if (!*line) return 0;
+
+    if (r->count == r->cap) {
+        int cap = r->cap ? r->cap * 2 : 16;
+        IgnoreRule *p = realloc(r->rules, (size_t)cap * sizeof(IgnoreRule));
+        if (!p) return -1;
+        r->rules = p;
+        r->cap = cap;
+    }
+    rule.pattern = strdup(line);
+    if (!rule.pattern) return -1;
+    r->rules[r->count] = rule;
+    return compile_rule(r, r->count++, anchored);
+}
+
+int ignore_load(IgnoreRules *r, const char *root) {
+    memset(r, 0, sizeof(*r));
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", root, IGNORE_FILE);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+
+    char line[1024];
+    int rc = 0;
+    while (rc == 0 && fgets(line, sizeof(line), fp))
+        rc = add_rule(r, line);
+    fclose(fp);
+
+    if (rc != 0) ignore_free(r);
+    return rc;
+}
+
+/* =============== MATCHING =================== */
+
+int ignore_match(const IgnoreRules *r, const char *rel_path, int is_dir) {
+    if (!r->count) return 0;
+
+    const char *name = strrchr(rel_path, '/');
+    name = name ? name + 1 : rel_path;
+    size_t name_len = strlen(name);
+
+    int best = -1;
+    best = table_find(r, &r->names, name, name_len, is_dir, best);
+    best = table_find(r, &r->paths, rel_path, strlen(rel_path), is_dir, best);
+    for (int i = 0; i < r->prefixes.len_count; i++) {
+        size_t len = r->prefixes.lens[i];
+        if (len <= name_len)
+            best = table_find(r, &r->prefixes, name, len, is_dir, best);
+    }
+    for (int i = 0; i < r->suffixes.len_count; i++) {
+        size_t len = r->suffixes.lens[i];
+        if (len <= name_len)
+            best = table_find(r, &r->suffixes, name + name_len - len, len, is_dir, best);
+    }
+
+    /* Globs are in rule order: the first hit from the end is the last */
+    for (int i = r->glob_count - 1; i >= 0 && r->globs[i].rule > best; i--) {
+        const IgnoreGlob *g = &r->globs[i];
+        if (r->rules[g->rule].dir_only && !is_dir) continue;
+        if (glob_run(g, g->anchored ? rel_path : name)) {
+            best = g->rule;
+            break;
+        }
+    }
+    return best >= 0 && !r->rules[best].negate;
+}
+
+void ignore_free(IgnoreRules *r) {
+    for (int i = 0; i < r->count; i++) free(r->rules[i].pattern);
+    free(r->rules);
+    table_free(&r->names);
+    table_free(&r->paths);
+    table_free(&r->prefixes);
+    table_free(&r->suffixes);
+    free(r->globs);
+    memset(r, 0, sizeof(*r));
+}
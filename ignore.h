@@ -0,0 +1,81 @@
+#ifndef IGNORE_H
+#define IGNORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IGNORE_FILE ".mgitignore"
+
+/* -------- Ignore rules read from a tree's .mgitignore -------- */
+/* One pattern per line; blank lines and lines starting with '#' are
+   skipped, and a leading '!' takes back what an earlier pattern
+   ignored (the last pattern that matches decides). A pattern without
+   a '/' matches an entry's name at any depth; one with a '/' (a
+   leading one is dropped) matches the whole path from the tree root.
+   A trailing '/' limits it to directories. '*' and '?' stay within
+   one path segment, a "**" segment spans any number of them, [...] is
+   a character class and '\' quotes the next character.
+
+   Patterns are compiled when loaded. Plain names and paths go into
+   hash tables, "name*" and "*suffix" into tables probed once per
+   distinct length, and only the rest become glob automata (a bitset
+   of positions stepped once per character), so testing an entry costs
+   a few lookups however many patterns there are. */
+#define IGNORE_GLOB_MAX 63        // positions in one automaton
+
+typedef struct IgnoreRule {
+    char *pattern;                // as written, without '!', '/' ends
+    int negate;
+    int dir_only;
+} IgnoreRule;
+
+typedef struct IgnoreKey {
+    const char *text;             // into a rule's pattern; NULL: empty slot
+    size_t len;
+    uint64_t hash;
+    int rule;
+} IgnoreKey;
+
+/* Literal strings, matched whole or as a name's prefix or suffix */
+typedef struct IgnoreTable {
+    IgnoreKey *slots;
+    size_t slot_count;            // power of two
+    int count;
+    size_t *lens;                 // distinct key lengths
+    int len_count;
+} IgnoreTable;
+
+typedef struct IgnoreGlob {
+    uint64_t step[256];           // positions a byte advances past
+    uint64_t loop[256];           // positions a byte stays in (stars)
+    uint64_t skip1;               // positions left without input
+    uint64_t skip3;               // "**/" matching no directory
+    int accept;                   // final position
+    const char *long_pattern;     // too many positions: run by fnmatch
+    int rule;
+    int anchored;                 // run on the whole path, not the name
+} IgnoreGlob;
+
+typedef struct IgnoreRules {
+    IgnoreRule *rules;
+    int count;
+    int cap;
+    IgnoreTable names;            // "name"
+    IgnoreTable paths;            // "dir/name"
+    IgnoreTable prefixes;         // "name*"
+    IgnoreTable suffixes;         // "*.ext"
+    IgnoreGlob *globs;
+    int glob_count;
+    int glob_cap;
+} IgnoreRules;
+
+/* Read and compile root/.mgitignore into r; a missing file gives no
+   rules. 0 on success, -1 if memory ran out. */
+int  ignore_load(IgnoreRules *r, const char *root);
+
+/* 1 if the entry at rel_path (relative to the root) is ignored */
+int  ignore_match(const IgnoreRules *r, const char *rel_path, int is_dir);
+
+void ignore_free(IgnoreRules *r);
+
+#endif /* IGNORE_H */
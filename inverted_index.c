@@ -1,242 +1,217 @@
 #include "inverted_index.h"
+
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <math.h>
-
-static char** tokenize(const char *text, int *count) {
-    char *copy = (char *)malloc(strlen(text) + 1);
-    strcpy(copy, copy);
-
-    char **tokens = (char **)malloc(sizeof(char *) * 1000);
-    *count = 0;
-
-    char *word = (char *)malloc(strlen(text) + 1);
-    int wordLen = 0;
-
-    for (int i = 0; text[i]; i++) {
-        if (isalnum((unsigned char)text[i]) || text[i] == '_') {
-            word[wordLen++] = tolower((unsigned char)text[i]);
-        } else {
-            if (wordLen > 1) {
-                word[wordLen] = '\0';
-                tokens[*count] = (char *)malloc(wordLen + 1);
-                strcpy(tokens[*count], word);
-                (*count)++;
-                wordLen = 0;
-            }
-        }
-    }
-    if (wordLen > 1) {
-        word[wordLen] = '\0';
-        tokens[*count] = (char *)malloc(wordLen + 1);
-        strcpy(tokens[*count], word);
-        (*count)++;
+
+#define INITIAL_SLOTS 1024
+
+static uint64_t term_hash(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ull;          // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
     }
+    return h;
+}
 
-    free(word);
-    free(copy);
-    return tokens;
-}
-
-InvertedIndex* invertedindex_create(void) {
-    InvertedIndex *index = (InvertedIndex *)malloc(sizeof(InvertedIndex));
-    index->terms = (char **)malloc(sizeof(char *) * 10000);
-    index->termCount = 0;
-    index->postings = (char ***)malloc(sizeof(char **) * 10000);
-    index->postingCounts = (int *)calloc(10000, sizeof(int));
-    index->idfCache = (double *)calloc(10000, sizeof(double));
-    index->idfCacheSize = 0;
-    index->documents = (DocumentInfo *)malloc(sizeof(DocumentInfo) * 10000);
-    index->documentCount = 0;
-    return index;
-}
-
-void invertedindex_addDocument(InvertedIndex *index, File *file) {
-    int tokenCount;
-    char *combined = (char *)malloc(strlen(file->content) + strlen(file->filename) + 2);
-    sprintf(combined, "%s %s", file->content, file->filename);
-    char **terms = tokenize(combined, &tokenCount);
-    free(combined);
-
-    DocumentInfo doc;
-    doc.fileId = (char *)malloc(strlen(file->id) + 1);
-    strcpy(doc.fileId, file->id);
-    doc.termFrequencies = (int *)calloc(tokenCount, sizeof(int));
-    doc.termCount = tokenCount;
-    doc.totalTerms = tokenCount;
-
-    for (int i = 0; i < tokenCount; i++) {
-        int termIdx = -1;
-        for (int j = 0; j < index->termCount; j++) {
-            if (strcmp(index->terms[j], terms[i]) == 0) {
-                termIdx = j;
-                break;
-            }
-        }
+/* =============== TOKENS =================== */
 
-        if (termIdx == -1) {
-            termIdx = index->termCount;
-            index->terms[termIdx] = (char *)malloc(strlen(terms[i]) + 1);
-            strcpy(index->terms[termIdx], terms[i]);
-            index->postings[termIdx] = (char **)malloc(sizeof(char *) * 10000);
-            index->postingCounts[termIdx] = 0;
-            index->termCount++;
-        }
+static int is_term_char(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
 
-        doc.termFrequencies[i]++;
+size_t inverted_index_next_term(const char **p, const char *end, char *term) {
+    const unsigned char *s = (const unsigned char *)*p;
+    const unsigned char *e = (const unsigned char *)end;
 
-        int found = 0;
-        for (int j = 0; j < index->postingCounts[termIdx]; j++) {
-            if (strcmp(index->postings[termIdx][j], file->id) == 0) {
-                found = 1;
-                break;
-            }
+    for (;;) {
+        while (s < e && !is_term_char(*s)) s++;
+        if (s == e) {
+            *p = end;
+            return 0;
         }
-        if (!found) {
-            index->postings[termIdx][index->postingCounts[termIdx]] = 
-                (char *)malloc(strlen(file->id) + 1);
-            strcpy(index->postings[termIdx][index->postingCounts[termIdx]], file->id);
-            index->postingCounts[termIdx]++;
+
+        size_t len = 0;
+        while (s < e && is_term_char(*s)) {
+            if (len < INDEX_TERM_MAX)
+                term[len] = (char)(*s >= 'A' && *s <= 'Z' ? *s - 'A' + 'a' : *s);
+            len++;
+            s++;
+        }
+        if (len <= INDEX_TERM_MAX) {
+            term[len] = '\0';
+            *p = (const char *)s;
+            return len;
         }
     }
+}
 
-    index->documents[index->documentCount] = doc;
-    index->documentCount++;
-
-    index->idfCacheSize = 0;
+/* =============== TERM TABLE =================== */
 
-    for (int i = 0; i < tokenCount; i++) {
-        free(terms[i]);
+/* Slot holding the term, or the empty slot where it would go */
+static size_t probe(const InvertedIndex *ix, const char *term, size_t len, uint64_t hash) {
+    size_t mask = ix->slot_count - 1;
+    size_t i = (size_t)hash & mask;
+    while (ix->slots[i]) {
+        const IndexTerm *t = &ix->terms[ix->slots[i] - 1];
+        if (t->hash == hash && t->len == len && memcmp(t->text, term, len) == 0) break;
+        i = (i + 1) & mask;
     }
-    free(terms);
-}
-
-double* invertedindex_search(InvertedIndex *index, const char *query, int *fileCount) {
-    int queryTokenCount;
-    char **queryTerms = tokenize(query, &queryTokenCount);
-    double *scores = (double *)calloc(10000, sizeof(double));
-    *fileCount = 0;
-
-    for (int i = 0; i < queryTokenCount; i++) {
-        int termIdx = -1;
-        for (int j = 0; j < index->termCount; j++) {
-            if (strcmp(index->terms[j], queryTerms[i]) == 0) {
-                termIdx = j;
-                break;
-            }
-        }
+    return i;
+}
 
-        if (termIdx != -1) {
-            double idf = invertedindex_getIDF(index, queryTerms[i]);
-            for (int j = 0; j < index->postingCounts[termIdx]; j++) {
-                // Add TF-IDF score
-                scores[j] += idf;
-            }
-        }
+static int grow_slots(InvertedIndex *ix) {
+    size_t count = ix->slot_count ? ix->slot_count * 2 : INITIAL_SLOTS;
+    int32_t *slots = calloc(count, sizeof(int32_t));
+    if (!slots) return -1;
+
+    free(ix->slots);
+    ix->slots = slots;
+    ix->slot_count = count;
+    for (int i = 0; i < ix->term_count; i++) {
+        const IndexTerm *t = &ix->terms[i];
+        ix->slots[probe(ix, t->text, t->len, t->hash)] = i + 1;
     }
+    return 0;
+}
 
-    for (int i = 0; i < queryTokenCount; i++) {
-        free(queryTerms[i]);
+const IndexTerm *inverted_index_find(const InvertedIndex *ix, const char *term, size_t len) {
+    if (!ix->slot_count) return NULL;
+    int32_t slot = ix->slots[probe(ix, term, len, term_hash(term, len))];
+    return slot ? &ix->terms[slot - 1] : NULL;
+}
+
+static IndexTerm *intern_term(InvertedIndex *ix, const char *term, size_t len) {
+    if ((size_t)(ix->term_count + 1) * 4 > ix->slot_count * 3 && grow_slots(ix) != 0)
+        return NULL;
+
+    uint64_t hash = term_hash(term, len);
+    size_t i = probe(ix, term, len, hash);
+    if (ix->slots[i]) return &ix->terms[ix->slots[i] - 1];
+
+    if (ix->term_count == ix->term_cap) {
+        int cap = ix->term_cap ? ix->term_cap * 2 : 1024;
+        IndexTerm *p = realloc(ix->terms, (size_t)cap * sizeof(IndexTerm));
+        if (!p) return NULL;
+        ix->terms = p;
+        ix->term_cap = cap;
     }
-    free(queryTerms);
+    const char *text = arena_strndup(&ix->strings, term, len);
+    if (!text) return NULL;
+
+    IndexTerm *t = &ix->terms[ix->term_count];
+    memset(t, 0, sizeof(*t));
+    t->text = text;
+    t->len = (uint32_t)len;
+    t->hash = hash;
+    ix->slots[i] = ++ix->term_count;
+    return t;
+}
+
+/* =============== POSTINGS =================== */
 
-    return scores;
+float inverted_index_norm(uint32_t doc_len, float avg_len) {
+    return BM25_K1 * (1.0f - BM25_B + BM25_B * (float)doc_len / avg_len);
 }
 
-char** invertedindex_getAllUniqueTerms(InvertedIndex *index, int *count) {
-    *count = index->termCount;
-    char **result = (char **)malloc(sizeof(char *) * index->termCount);
-    for (int i = 0; i < index->termCount; i++) {
-        result[i] = (char *)malloc(strlen(index->terms[i]) + 1);
-        strcpy(result[i], index->terms[i]);
+float inverted_index_avg_len(const InvertedIndex *ix) {
+    return ix->doc_count && ix->total_len ? (float)((double)ix->total_len / ix->doc_count)
+                                          : 1.0f;
+}
+
+static IndexBlock scan_block(const InvertedIndex *ix, const IndexTerm *t, int b) {
+    int start = b << INDEX_BLOCK_SHIFT;
+    int end = start + INDEX_BLOCK_SIZE < t->count ? start + INDEX_BLOCK_SIZE : t->count;
+    IndexBlock blk = { 0.0f, inverted_index_avg_len(ix) };
+    for (int i = start; i < end; i++) {
+        const Posting *p = &t->postings[i];
+        float ratio = (float)p->tf / inverted_index_norm(ix->doc_lens[p->doc], blk.avg_len);
+        if (ratio > blk.max_ratio) blk.max_ratio = ratio;
     }
-    return result;
+    return blk;
 }
 
-double invertedindex_getIDF(InvertedIndex *index, const char *term) {
-    for (int i = 0; i < index->termCount; i++) {
-        if (strcmp(index->terms[i], term) == 0) {
-            if (index->idfCache[i] > 0) {
-                return index->idfCache[i];
-            }
+float inverted_index_block_ratio(const InvertedIndex *ix, const IndexTerm *t, int b) {
+    if (b >= t->block_count) return scan_block(ix, t, b).max_ratio;
 
-            int docFreq = index->postingCounts[i];
-            int totalDocs = index->documentCount;
+    /* norm(len) at a larger average is at least avg_then / avg_now of
+       what it was, so the ratio grew by at most the inverse */
+    const IndexBlock *blk = &t->blocks[b];
+    float avg_len = inverted_index_avg_len(ix);
+    return avg_len > blk->avg_len ? blk->max_ratio * (avg_len / blk->avg_len) : blk->max_ratio;
+}
 
-            double idf = docFreq > 0 ? log((double)totalDocs / docFreq) : 0;
-            index->idfCache[i] = idf;
-            return idf;
-        }
+/* Record the bound of the last full block; called as the posting
+   after it is added, for a later document, so its own are complete */
+static int seal_block(const InvertedIndex *ix, IndexTerm *t) {
+    if (t->block_count == t->block_cap) {
+        int cap = t->block_cap ? t->block_cap * 2 : 4;
+        IndexBlock *p = realloc(t->blocks, (size_t)cap * sizeof(IndexBlock));
+        if (!p) return -1;
+        t->blocks = p;
+        t->block_cap = cap;
     }
+    t->blocks[t->block_count] = scan_block(ix, t, t->block_count);
+    t->block_count++;
     return 0;
 }
 
-int invertedindex_getTermFrequency(InvertedIndex *index, const char *fileId, const char *term) {
-    for (int i = 0; i < index->documentCount; i++) {
-        if (strcmp(index->documents[i].fileId, fileId) == 0) {
-            for (int j = 0; j < index->documents[i].termCount; j++) {
-                // Simplified - would need to track term names in DocumentInfo
-                if (index->documents[i].termFrequencies[j] > 0) {
-                    return index->documents[i].termFrequencies[j];
-                }
-            }
-        }
+static int add_posting(const InvertedIndex *ix, IndexTerm *t, uint32_t doc, uint32_t weight) {
+    if (t->count && t->postings[t->count - 1].doc == doc) {
+        t->postings[t->count - 1].tf += weight;
+        return 0;
+    }
+    if (t->count && (t->count & (INDEX_BLOCK_SIZE - 1)) == 0 && seal_block(ix, t) != 0)
+        return -1;
+    if (t->count == t->cap) {
+        int cap = t->cap ? t->cap * 2 : 4;
+        Posting *p = realloc(t->postings, (size_t)cap * sizeof(Posting));
+        if (!p) return -1;
+        t->postings = p;
+        t->cap = cap;
     }
+    t->postings[t->count++] = (Posting){ doc, weight };
     return 0;
 }
 
-int invertedindex_getDocumentLength(InvertedIndex *index, const char *fileId) {
-    for (int i = 0; i < index->documentCount; i++) {
-        if (strcmp(index->documents[i].fileId, fileId) == 0) {
-            return index->documents[i].totalTerms;
-        }
+static int reserve_doc(InvertedIndex *ix, uint32_t doc) {
+    if (doc >= ix->doc_cap) {
+        uint32_t cap = ix->doc_cap ? ix->doc_cap : 1024;
+        while (cap <= doc) cap *= 2;
+        uint32_t *p = realloc(ix->doc_lens, (size_t)cap * sizeof(uint32_t));
+        if (!p) return -1;
+        memset(p + ix->doc_cap, 0, (size_t)(cap - ix->doc_cap) * sizeof(uint32_t));
+        ix->doc_lens = p;
+        ix->doc_cap = cap;
     }
+    if (doc >= ix->doc_count) ix->doc_count = doc + 1;
     return 0;
 }
 
-double invertedindex_getAverageDocumentLength(InvertedIndex *index) {
-    if (index->documentCount == 0) return 0;
-    int total = 0;
-    for (int i = 0; i < index->documentCount; i++) {
-        total += index->documents[i].totalTerms;
-    }
-    return (double)total / index->documentCount;
-}
-
-void invertedindex_removeDocument(InvertedIndex *index, const char *fileId) {
-    for (int i = 0; i < index->documentCount; i++) {
-        if (strcmp(index->documents[i].fileId, fileId) == 0) {
-            free(index->documents[i].fileId);
-            free(index->documents[i].termFrequencies);
-            // Shift remaining documents
-            for (int j = i; j < index->documentCount - 1; j++) {
-                index->documents[j] = index->documents[j + 1];
-            }
-            index->documentCount--;
-            index->idfCacheSize = 0;
-            break;
-        }
+int inverted_index_add(InvertedIndex *ix, uint32_t doc, const char *text,
+                       size_t len, uint32_t weight) {
+    const char *p = text, *end = text + len;
+    char term[INDEX_TERM_MAX + 1];
+    size_t n;
+
+    if (reserve_doc(ix, doc) != 0) return -1;
+    while ((n = inverted_index_next_term(&p, end, term)) > 0) {
+        IndexTerm *t = intern_term(ix, term, n);
+        if (!t || add_posting(ix, t, doc, weight) != 0) return -1;
+        ix->doc_lens[doc] += weight;
+        ix->total_len += weight;
     }
+    return 0;
 }
 
-void invertedindex_free(InvertedIndex *index) {
-    if (!index) return;
-    for (int i = 0; i < index->termCount; i++) {
-        free(index->terms[i]);
-        for (int j = 0; j < index->postingCounts[i]; j++) {
-            free(index->postings[i][j]);
-        }
-        free(index->postings[i]);
+void inverted_index_free(InvertedIndex *ix) {
+    for (int i = 0; i < ix->term_count; i++) {
+        free(ix->terms[i].postings);
+        free(ix->terms[i].blocks);
     }
-    free(index->terms);
-    free(index->postings);
-    free(index->postingCounts);
-    free(index->idfCache);
-    for (int i = 0; i < index->documentCount; i++) {
-        free(index->documents[i].fileId);
-        free(index->documents[i].termFrequencies);
-    }
-    free(index->documents);
-    free(index);
-}
\ No newline at end of file
+    free(ix->terms);
+    free(ix->doc_lens);
+    free(ix->slots);
+    arena_free_all(&ix->strings);
+    memset(ix, 0, sizeof(*ix));
+}
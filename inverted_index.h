@@ -1,35 +1,92 @@
 #ifndef INVERTED_INDEX_H
 #define INVERTED_INDEX_H
 
-#include "schema.h"
-
-typedef struct {
-    char *fileId;
-    int *termFrequencies;
-    int termCount;
-    int totalTerms;
-} DocumentInfo;
-
-typedef struct {
-    char **terms;
-    int termCount;
-    char ***postings; // postings[i] = fileIds for term i
-    int *postingCounts;
-    double *idfCache;
-    int idfCacheSize;
-    DocumentInfo *documents;
-    int documentCount;
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define INDEX_TERM_MAX 64         // longer runs (hashes, base64) are not indexed
+#define INDEX_BLOCK_SHIFT 7
+#define INDEX_BLOCK_SIZE (1 << INDEX_BLOCK_SHIFT)   // postings per score block
+#define BM25_K1 1.2f
+#define BM25_B 0.75f
+
+/* -------- Term -> postings index over the search documents -------- */
+/* Terms are runs of ASCII letters and digits, lowercased, so
+   "search_engine.c" holds "search", "engine" and "c". Each term keeps
+   its postings in increasing document order: documents are indexed
+   one at a time with growing ids, so a list only ever grows at its end
+   and repeated terms of the current document add up in the last
+   posting. Terms are found through an open-addressing hash table; the
+   strings live in an arena.
+
+   For BM25 ranking, the index keeps each document's length (its
+   weighted term count) and cuts every postings list into blocks of
+   INDEX_BLOCK_SIZE, recording the largest tf / norm(length) in each:
+   BM25 grows with that ratio, so it bounds the score of every document
+   in the block without reading the postings. A block's figure is taken
+   once all its documents are complete, when the next block is started,
+   along with the average length it was taken at (see
+   inverted_index_block_ratio); the open last block is scanned on demand. */
+typedef struct Posting {
+    uint32_t doc;
+    uint32_t tf;                  // occurrences in the document, weighted
+} Posting;
+
+typedef struct IndexBlock {
+    float max_ratio;              // largest tf / norm(doc length)
+    float avg_len;                // average document length at the time
+} IndexBlock;
+
+typedef struct IndexTerm {
+    const char *text;             // in strings
+    uint32_t len;
+    uint64_t hash;
+    Posting *postings;
+    int count;
+    int cap;
+    IndexBlock *blocks;           // all full blocks but the last one
+    int block_count;
+    int block_cap;
+} IndexTerm;
+
+typedef struct InvertedIndex {
+    IndexTerm *terms;
+    int term_count;
+    int term_cap;
+    int32_t *slots;               // term index + 1, 0 if empty
+    size_t slot_count;            // power of two
+    Arena strings;
+    uint32_t *doc_lens;           // weighted term count per document
+    uint32_t doc_count;           // highest document indexed + 1
+    uint32_t doc_cap;
+    uint64_t total_len;
 } InvertedIndex;
 
-InvertedIndex* invertedindex_create(void);
-void invertedindex_addDocument(InvertedIndex *index, File *file);
-double* invertedindex_search(InvertedIndex *index, const char *query, int *fileCount);
-char** invertedindex_getAllUniqueTerms(InvertedIndex *index, int *count);
-double invertedindex_getIDF(InvertedIndex *index, const char *term);
-int invertedindex_getTermFrequency(InvertedIndex *index, const char *fileId, const char *term);
-int invertedindex_getDocumentLength(InvertedIndex *index, const char *fileId);
-double invertedindex_getAverageDocumentLength(InvertedIndex *index);
-void invertedindex_removeDocument(InvertedIndex *index, const char *fileId);
-void invertedindex_free(InvertedIndex *index);
-
-#endif
\ No newline at end of file
+/* Next term in [*p, end) copied to term (INDEX_TERM_MAX + 1 bytes);
+   *p moves past it. Returns its length, 0 once the text is used up. */
+size_t inverted_index_next_term(const char **p, const char *end, char *term);
+
+/* Index text as part of document doc, each occurrence counting weight.
+   doc must not be lower than any document indexed before. 0 on
+   success, -1 if memory ran out (the document is then partly indexed). */
+int inverted_index_add(InvertedIndex *ix, uint32_t doc, const char *text,
+                       size_t len, uint32_t weight);
+
+const IndexTerm *inverted_index_find(const InvertedIndex *ix, const char *term, size_t len);
+
+/* BM25 length normalization, K1 * (1 - B + B * doc_len / avg_len) */
+float inverted_index_norm(uint32_t doc_len, float avg_len);
+
+float inverted_index_avg_len(const InvertedIndex *ix);
+
+/* Bound on tf / norm(doc length) over block b of t's postings, which
+   holds postings [b * INDEX_BLOCK_SIZE, (b + 1) * INDEX_BLOCK_SIZE), at
+   the current average length. If documents added since the block was
+   sealed raised the average, its figure is scaled up to cover that. */
+float inverted_index_block_ratio(const InvertedIndex *ix, const IndexTerm *t, int b);
+
+void inverted_index_free(InvertedIndex *ix);
+
+#endif /* INVERTED_INDEX_H */
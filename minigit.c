@@ -2,6 +2,20 @@
 #include "trie_index.h"
 #include "autocomplete.h"
 #include "search_engine.h"
+#include "object_store.h"
+#include "repo_store.h"
+#include "pack.h"
+#include "work_index.h"
+#include "snapshot_pipeline.h"
+#include "worker_pool.h"
+#include "wal.h"
+#include "diff.h"
+#include "gc.h"
+#include "codec.h"
+#include "span.h"
+#include "staging.h"
+#include "tree_walk.h"
+#include "ignore.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,14 +25,15 @@
 
 #include <unistd.h>     // getcwd, access
 #include <sys/stat.h>   // mkdir
-#include <dirent.h>     // DIR, opendir, readdir, closedir
 #define MGIT_DEBUG 0
 
 #define WORKING_DIR ".mgit_work"
 
 /* Globals */
 Repository repo;
-File *index_head = NULL;
+static StagingArea staging;       // files added for the next commit
+static WorkIndex work_index;      // stat cache of files already hashed
+static RepoConfig repo_config;    // .mgit/config
 
 /* ---------- Helpers ---------- */
 
@@ -48,61 +63,299 @@ static void normalize_word_for_trie(char *word) {
     word[w] = '\0';
 }
 
-/* =============== FILE INDEXING =================== */
+static int ignore_hook(void *ctx, const char *rel_path, int is_dir) {
+    return ignore_match((const IgnoreRules *)ctx, rel_path, is_dir);
+}
 
-static void index_file_for_search(const char *filename) {
+/* Files below .mgit_work/, less what its .mgitignore rules out; ignored
+   directories are not entered at all */
+static int walk_working_dir(WalkResult *tree) {
+    IgnoreRules rules;
+    if (ignore_load(&rules, WORKING_DIR) != 0) {
+        memset(tree, 0, sizeof(*tree));
+        return -1;
+    }
+    int rc = tree_walk(WORKING_DIR, ignore_hook, &rules, tree);
+    ignore_free(&rules);
+    return rc;
+}
 
-#if MGIT_DEBUG
-    printf("[DEBUG] index_file_for_search CALLED for: %s\n", filename);
-#endif
+/* Content hash of a working file, reading it only if its stat changed */
+static int working_file_id(const char *path, ObjectId *out, int *reread) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp) return;
+    WorkIndexEntry *e = work_index_lookup(&work_index, path, &st);
+    if (e) {
+        *out = e->id;
+        return 0;
+    }
+    if (hash_file(path, out, NULL) != 0) return -1;
+    work_index_update(&work_index, path, &st, out);
+    (*reread)++;
+    return 0;
+}
 
-    char line[1024];
+/* Print text as-is; flag content with NUL bytes as binary (like git) */
+typedef struct ViewState {
+    int first_chunk;
+    int binary;
+} ViewState;
+
+static int sink_to_stdout(const unsigned char *chunk, size_t len, void *ctx) {
+    ViewState *vs = (ViewState *)ctx;
+    if (vs->first_chunk) {
+        vs->first_chunk = 0;
+        size_t probe = len < 8000 ? len : 8000;
+        if (memchr(chunk, '\0', probe)) {
+            vs->binary = 1;
+            return 1;                             // stop streaming
+        }
+    }
+    fwrite(chunk, 1, len, stdout);
+    return 0;
+}
 
-    while (fgets(line, sizeof(line), fp)) {
+/* -------- Files gathered for a commit before it is laid out -------- */
+typedef struct FileList {
+    CommitFile *items;            // filenames already live in repo.arena
+    int count;
+    int cap;
+} FileList;
+
+static int file_list_push(FileList *l, const char *name, Blob *blob) {
+    if (l->count == l->cap) {
+        int cap = l->cap ? l->cap * 2 : 16;
+        CommitFile *p = realloc(l->items, (size_t)cap * sizeof(CommitFile));
+        if (!p) return -1;
+        l->items = p;
+        l->cap = cap;
+    }
+    l->items[l->count].filename = arena_strdup(&repo.arena, name);
+    l->items[l->count].blob = blob;
+    l->count++;
+    return 0;
+}
 
-        int i = 0, len = strlen(line);
+/* Put c on top of the history and make it findable */
+static void link_commit(Commit *c) {
+    c->next = repo.head;
+    c->prev = NULL;
+    if (repo.head) repo.head->prev = c;
+    repo.head = c;
+    if (c->commit_id > repo.commit_count)
+        repo.commit_count = c->commit_id;
+
+    compute_commit_hash(c);
+    commit_index_insert(&repo.index, c);
+    if (commit_graph_append(&repo.graph, c) != 0)
+        commit_graph_rebuild(&repo.graph, repo.head);
+}
 
-        while (i < len) {
+/* Lay the commit out in the arena (exactly count files) and link it
+   on top of the history. Takes over the blob references in files. */
+static Commit *publish_commit(const char *msg, FileList *files) {
+    Commit *c = arena_alloc(&repo.arena, sizeof(Commit));
+    CommitFile *cfs = files->count
+        ? arena_alloc(&repo.arena, (size_t)files->count * sizeof(CommitFile))
+        : NULL;
+    const char *message = arena_strdup(&repo.arena, msg);
+    if (!c || (files->count && !cfs) || !message) return NULL;
+
+    if (files->count)
+        memcpy(cfs, files->items, (size_t)files->count * sizeof(CommitFile));
+
+    c->commit_id = repo.commit_count + 1;
+    c->parent_id = repo.head ? repo.head->commit_id : 0;
+    c->timestamp = (long)time(NULL);
+    c->message = message;
+    c->files = cfs;
+    c->file_count = files->count;
+    link_commit(c);
+    return c;
+}
 
-            char word[256];
-            int w = 0;
+/* History is linear: the only child is the newer neighbour */
+static void unlink_commit(Commit *c) {
+    if (c->prev) {
+        c->prev->next = c->next;
+        c->prev->parent_id = c->parent_id;
+    } else {
+        repo.head = c->next;
+    }
+    if (c->next)
+        c->next->prev = c->prev;
 
-            while (i < len && (isalnum(line[i]) || line[i]=='_')) {
-                word[w++] = tolower(line[i]);
-                i++;
-            }
+    commit_index_remove(&repo.index, c->commit_id);
+    commit_graph_remove(&repo.graph, c->commit_id);
+}
 
-            word[w] = '\0';
+static void log_commit(const Commit *c) {
+    if (repo_store_log_commit(&repo, c) != 0)
+        printf("Warning: could not write %s\n", REPO_WAL);
+}
 
-            if (w > 0) {
-#if MGIT_DEBUG
-                printf("[DEBUG] CLEAN WORD: '%s'\n", word);
-#endif
-                add_autocomplete_suggestion(word, 0.6f, AC_SOURCE_DOCUMENT_TITLES);
+static void persist_work_index(void) {
+    if (work_index.dirty && work_index_save(&work_index, REPO_INDEX) != 0)
+        printf("Warning: could not write %s\n", REPO_INDEX);
+}
+
+/* The record itself stays in the arena until the repository is reset */
+static void release_commit(Commit *c) {
+    for (int i = 0; i < c->file_count; i++)
+        blob_release(c->files[i].blob);
+    c->file_count = 0;
+}
 
-                char trie_word[256];
-                int tw = 0;
+/* =============== FILE INDEXING =================== */
 
-                for (int j = 0; j < w; j++)
-                    if (word[j] >= 'a' && word[j] <= 'z')
-                        trie_word[tw++] = word[j];
+/* Feed a word fragment (NUL-separated) to autocomplete and the trie */
+static void merge_words_for_search(const ByteBuf *words, const char *filename) {
+    const char *p = (const char *)words->data;
+    const char *end = p + words->len;
 
-                trie_word[tw] = '\0';
+    while (p < end) {
+        const char *word = p;
+        p += strlen(word) + 1;
 
-                if (tw > 0)
-                    trie_insert_word(trie_word, filename);
-            }
+        add_autocomplete_suggestion(word, 0.6f, AC_SOURCE_DOCUMENT_TITLES);
+
+        /* The search trie only knows a-z */
+        char trie_word[WORD_MAX_LEN + 1];
+        int tw = 0;
+        for (int j = 0; word[j]; j++)
+            if (word[j] >= 'a' && word[j] <= 'z')
+                trie_word[tw++] = word[j];
+        trie_word[tw] = '\0';
 
-            i++;
+        if (tw > 0)
+            trie_insert_word(trie_word, filename);
+    }
+}
+
+/* =============== SNAPSHOT PIPELINE =================== */
+
+/* One file headed for a commit */
+typedef struct PendingFile {
+    char path[STAGING_PATH_MAX];
+    const char *name;             // name in the commit; NULL: the basename
+    struct stat st;               // taken before reading: later edits show up
+    const StagedFile *staged;     // set if added: its blob is used while unchanged
+    Blob *blob;                   // cache hit, or installed from the job
+    int job;                      // slot in the jobs array, -1 if none
+    int is_new;                   // blob stored for the first time
+    int skip;
+} PendingFile;
+
+static int pending_push(PendingFile **items, int *count, int *cap, const char *path) {
+    if (*count == *cap) {
+        int ncap = *cap ? *cap * 2 : 16;
+        PendingFile *p = realloc(*items, (size_t)ncap * sizeof(PendingFile));
+        if (!p) return -1;
+        *items = p;
+        *cap = ncap;
+    }
+    PendingFile *pf = &(*items)[(*count)++];
+    memset(pf, 0, sizeof(*pf));
+    snprintf(pf->path, sizeof(pf->path), "%s", path);
+    pf->job = -1;
+    return 0;
+}
+
+/* Files in flight in one pipeline run: each job holds a temporary
+   object file open and its words in memory until it is installed */
+#define SNAPSHOT_BATCH 1024
+
+/* Snapshot the files into list (in order). Unchanged files come from the
+   staging area or the stat cache; the rest are read, hashed, written
+   and tokenized by the worker pipeline, then installed and merged into
+   the search index here, on this thread, in staging order. With a NULL
+   list each pf[i].blob is left to the caller (one reference, or NULL
+   if skipped). Returns the number of new blobs. */
+static int snapshot_batch(PendingFile *pf, int count, FileList *list, int warn) {
+    SnapshotJob *jobs = count ? calloc((size_t)count, sizeof(SnapshotJob)) : NULL;
+    int njobs = 0, new_blobs = 0;
+    if (count && !jobs) return 0;
+
+    for (int i = 0; i < count; i++) {
+        if (stat(pf[i].path, &pf[i].st) != 0) {
+            pf[i].skip = 1;
+            continue;
+        }
+        if (pf[i].staged && staging_unchanged(pf[i].staged, &pf[i].st)) {
+            pf[i].blob = blob_retain(pf[i].staged->blob);
+            pf[i].is_new = pf[i].staged->is_new;
+            new_blobs += pf[i].is_new;
+            continue;                             // read, stored and indexed by add
         }
+
+        WorkIndexEntry *e = work_index_lookup(&work_index, pf[i].path, &pf[i].st);
+        Blob *cached = e ? object_store_get(&e->id) : NULL;
+        if (cached) {
+            pf[i].blob = blob_retain(cached);
+            if (e->indexed) continue;             // nothing to read at all
+        }
+
+        SnapshotJob *job = &jobs[njobs];
+        job->path = pf[i].path;
+        job->store = cached == NULL;
+        job->tokenize = 1;
+        pf[i].job = njobs++;
     }
 
-    fclose(fp);
+    snapshot_pipeline_run(jobs, njobs);
+
+    for (int i = 0; i < count; i++) {
+        SnapshotJob *job = pf[i].job >= 0 ? &jobs[pf[i].job] : NULL;
+
+        if (job && job->failed) {
+            if (job->store) pf[i].skip = 1;
+            else job = NULL;                      // still committed, just not indexed
+        }
+        if (pf[i].skip) {
+            if (warn) printf("Warning: could not read %s, skipped.\n", pf[i].path);
+            blob_release(pf[i].blob);
+            pf[i].blob = NULL;
+            continue;
+        }
+
+        if (job && job->store) {
+            pf[i].blob = object_writer_finish(&job->writer, &pf[i].is_new);
+            if (!pf[i].blob) continue;
+            new_blobs += pf[i].is_new;
+            work_index_update(&work_index, pf[i].path, &pf[i].st, &pf[i].blob->id);
+        }
+
+        WorkIndexEntry *e = work_index_find(&work_index, pf[i].path);
+        if (job && !(e && e->indexed)) {
+            merge_words_for_search(&job->words, pf[i].path);
+            if (e) e->indexed = 1;
+        }
+
+        if (!list) continue;
+        const char *name = pf[i].name;
+        if (!name) {
+            name = strrchr(pf[i].path, '/');
+            name = name ? name + 1 : pf[i].path;
+        }
+        if (file_list_push(list, name, pf[i].blob) != 0)
+            blob_release(pf[i].blob);
+    }
+
+    for (int j = 0; j < njobs; j++)
+        snapshot_job_free(&jobs[j]);
+    free(jobs);
+    return new_blobs;
 }
 
+static int snapshot_files(PendingFile *pf, int count, FileList *list, int warn) {
+    int new_blobs = 0;
+    for (int i = 0; i < count; i += SNAPSHOT_BATCH) {
+        int n = count - i < SNAPSHOT_BATCH ? count - i : SNAPSHOT_BATCH;
+        new_blobs += snapshot_batch(pf + i, n, list, warn);
+    }
+    return new_blobs;
+}
 
 /* =============== COMMIT MESSAGE INDEXING =================== */
 
@@ -149,42 +402,242 @@ static void index_commit_message(const char *msg, int commit_id) {
     add_document_to_search_engine_virtual(&doc);
 }
 
+/* =============== COMMIT LOOKUP =================== */
+
+/* The parent link is left out so re-parenting keeps the hash stable */
+void compute_commit_hash(Commit *c) {
+    HashContext ctx;
+    unsigned char num[8];
+
+    hash_init(&ctx);
+    for (int i = 0; i < 4; i++) num[i] = (unsigned char)((unsigned)c->commit_id >> (8 * i));
+    hash_update(&ctx, num, 4);
+    for (int i = 0; i < 8; i++) num[i] = (unsigned char)((unsigned long long)c->timestamp >> (8 * i));
+    hash_update(&ctx, num, 8);
+    hash_update(&ctx, c->message, strlen(c->message) + 1);
+
+    for (int i = 0; i < c->file_count; i++) {
+        hash_update(&ctx, c->files[i].filename, strlen(c->files[i].filename) + 1);
+        hash_update(&ctx, c->files[i].blob->id.hash, OBJECT_ID_RAWSZ);
+    }
+    hash_final(&ctx, &c->hash);
+}
+
+Commit *find_commit(int cid) {
+    return commit_index_find(&repo.index, cid);
+}
+
+Commit *find_commit_by_prefix(const char *hex_prefix) {
+    int ambiguous = 0;
+    Commit *c = commit_index_find_prefix(&repo.index, hex_prefix, &ambiguous);
+    if (ambiguous)
+        printf("Hash prefix '%s' is ambiguous.\n", hex_prefix);
+    return c;
+}
+
+/* Accept a commit id ("12") or an abbreviated hash ("3fa9c1") */
+int resolve_commit_ref(const char *ref) {
+    if (!ref) return -1;
+    while (*ref == ' ') ref++;
+
+    int all_digits = *ref != '\0';
+    for (const char *p = ref; *p; p++)
+        if (!isdigit((unsigned char)*p)) all_digits = 0;
+
+    if (all_digits && find_commit(atoi(ref)))
+        return atoi(ref);
+
+    if (strlen(ref) >= 4) {
+        Commit *c = find_commit_by_prefix(ref);
+        if (c) return c->commit_id;
+    }
+    return all_digits ? atoi(ref) : -1;
+}
+
 /* =============== SIMPLE VCS OPERATIONS =================== */
 
-/* Checkout: write commit snapshots to .mgit_work/<filename> */
+/* -------- A commit's files sorted by name, for sweeps of .mgit_work/ -------- */
+typedef struct FileMap {
+    CommitFile **sorted;
+    char *seen;                   // per sorted slot: found in the sweep
+    int count;
+} FileMap;
+
+static int cmp_commit_file_name(const void *a, const void *b) {
+    return strcmp((*(const CommitFile *const *)a)->filename,
+                  (*(const CommitFile *const *)b)->filename);
+}
+
+static int file_map_build(FileMap *m, Commit *c) {
+    m->count = c ? c->file_count : 0;
+    m->sorted = m->count ? malloc((size_t)m->count * sizeof(CommitFile *)) : NULL;
+    m->seen = m->count ? calloc((size_t)m->count, 1) : NULL;
+    if (m->count && (!m->sorted || !m->seen)) {
+        free(m->sorted);
+        free(m->seen);
+        return -1;
+    }
+    for (int i = 0; i < m->count; i++)
+        m->sorted[i] = &c->files[i];
+    if (m->count)
+        qsort(m->sorted, (size_t)m->count, sizeof(CommitFile *), cmp_commit_file_name);
+    return 0;
+}
+
+/* Slot of name in m->sorted, or -1 */
+static int file_map_find(const FileMap *m, const char *name) {
+    if (!m->count) return -1;
+    CommitFile key = { name, NULL };
+    CommitFile *kp = &key;
+    CommitFile **hit = bsearch(&kp, m->sorted, (size_t)m->count,
+                               sizeof(CommitFile *), cmp_commit_file_name);
+    return hit ? (int)(hit - m->sorted) : -1;
+}
+
+static void file_map_free(FileMap *m) {
+    free(m->sorted);
+    free(m->seen);
+}
+
+/* Create the missing directories above path inside .mgit_work/ */
+static void make_parent_dirs(const char *path) {
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + strlen(WORKING_DIR) + 1; (p = strchr(p, '/')); p++) {
+        *p = '\0';
+        mkdir(dir, 0700);
+        *p = '/';
+    }
+}
+
+/* Remove the directories above path that it leaves empty */
+static void remove_empty_parents(const char *path) {
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash;
+    while ((slash = strrchr(dir, '/')) && (size_t)(slash - dir) > strlen(WORKING_DIR)) {
+        *slash = '\0';
+        if (rmdir(dir) != 0) break;
+    }
+}
+
+/* Files of one checkout that need writing, done on the worker pool */
+typedef struct CheckoutJob {
+    const CommitFile **files;
+    char (*paths)[512];
+    int *status;
+} CheckoutJob;
+
+static void checkout_one(void *ctx, int i) {
+    CheckoutJob *job = (CheckoutJob *)ctx;
+    job->status[i] = blob_materialize(job->files[i]->blob, job->paths[i]);
+}
+
+/* Checkout: make .mgit_work/ match the commit. Files already holding the
+   right content are skipped (judged through the stat cache, so they are
+   usually not even read); files not in the commit are removed if their
+   content is committed, so nothing unsaved is lost. Ignored files are
+   left alone. */
 void checkout_commit(int cid) {
     ensure_working_dir();
 
-    Commit *temp = repo.head;
-    while (temp) {
-        if (temp->commit_id == cid) {
-            printf("Checking out commit %d...\n", cid);
+    Commit *temp = find_commit(cid);
+    if (!temp) {
+        printf("Commit %d not found.\n", cid);
+        return;
+    }
 
-            for (int i = 0; i < temp->file_count; i++) {
-                CommitFile *cf = &temp->files[i];
+    printf("Checking out commit %d...\n", cid);
+
+    FileMap map;
+    int n = temp->file_count;
+    CheckoutJob job = { NULL, NULL, NULL };
+    job.files = n ? malloc((size_t)n * sizeof(*job.files)) : NULL;
+    job.paths = n ? malloc((size_t)n * sizeof(*job.paths)) : NULL;
+    job.status = n ? malloc((size_t)n * sizeof(int)) : NULL;
+    if ((n && (!job.files || !job.paths || !job.status)) || file_map_build(&map, temp) != 0) {
+        free(job.files);
+        free(job.paths);
+        free(job.status);
+        printf("Memory allocation failed.\n");
+        return;
+    }
 
-                char path[512];
-                snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, cf->filename);
+    int unchanged = 0, removed = 0, kept = 0, reread = 0;
+    size_t bytes_avoided = 0;
 
-                FILE *fp = fopen(path, "w");
-                if (!fp) {
-                    printf("Error writing %s\n", path);
-                    continue;
-                }
+    /* Sweep the working dir: match against the commit, drop stale files */
+    WalkResult tree;
+    walk_working_dir(&tree);
+    for (int t = 0; t < tree.count; t++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, tree.files[t]);
 
-                fprintf(fp, "%s", cf->content);
-                fclose(fp);
+        ObjectId id;
+        if (working_file_id(path, &id, &reread) != 0) continue;
 
-                printf("  Wrote %s\n", path);
+        int slot = file_map_find(&map, tree.files[t]);
+        if (slot >= 0) {
+            if (object_id_equal(&id, &map.sorted[slot]->blob->id)) {
+                map.seen[slot] = 1;
+                unchanged++;
+                bytes_avoided += map.sorted[slot]->blob->size;
             }
+            continue;
+        }
 
-            printf("Files written to %s/\n", WORKING_DIR);
-            return;
+        if (object_store_get(&id) && unlink(path) == 0) {
+            work_index_remove(&work_index, path);
+            remove_empty_parents(path);
+            printf("  Removed %s\n", path);
+            removed++;
+        } else {
+            kept++;
+        }
+    }
+    walk_result_free(&tree);
+
+    int nwrite = 0;
+    for (int i = 0; i < map.count; i++) {
+        if (map.seen[i]) continue;
+        job.files[nwrite] = map.sorted[i];
+        snprintf(job.paths[nwrite], sizeof(job.paths[nwrite]), "%s/%s",
+                 WORKING_DIR, map.sorted[i]->filename);
+        nwrite++;
+    }
+
+    /* Directories first: the files are then written in parallel */
+    for (int i = 0; i < nwrite; i++)
+        make_parent_dirs(job.paths[i]);
+    parallel_for(nwrite, checkout_one, &job);
+
+    int written = 0;
+    for (int i = 0; i < nwrite; i++) {
+        const char *path = job.paths[i];
+        if (job.status[i] != 0) {
+            printf("Error writing %s (object missing or disk full)\n", path);
+            continue;
         }
-        temp = temp->next;
+
+        /* The content is known: the next save need not re-read it */
+        struct stat st;
+        if (stat(path, &st) == 0)
+            work_index_update(&work_index, path, &st, &job.files[i]->blob->id);
+
+        printf("  Wrote %s\n", path);
+        written++;
     }
 
-    printf("Commit %d not found.\n", cid);
+    file_map_free(&map);
+    free(job.files);
+    free(job.paths);
+    free(job.status);
+    persist_work_index();
+
+    printf("Files written to %s/ (%d written, %d unchanged, %d removed",
+           WORKING_DIR, written, unchanged, removed);
+    if (kept) printf(", %d uncommitted kept", kept);
+    printf("; %zu bytes not rewritten).\n", bytes_avoided);
 }
 
 /* Very simple in-terminal editor */
@@ -194,22 +647,20 @@ void edit_file(const char *filename) {
     char path[512];
     snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, filename);
 
-    FILE *fp = fopen(path, "r");
-    if (!fp) {
+    Span span;
+    if (span_open_file(path, &span) != 0) {
         printf("File not found in working directory: %s\n", path);
         return;
     }
 
     printf("\n--- Current content of %s ---\n", filename);
-    char line[512];
-    while (fgets(line, sizeof(line), fp)) {
-        printf("%s", line);
-    }
-    fclose(fp);
+    fwrite(span.data, 1, span.size, stdout);
+    span_close(&span);
 
     printf("\n--- Enter new content (END with a single line containing 'EOF') ---\n");
 
-    fp = fopen(path, "w");
+    char line[512];
+    FILE *fp = fopen(path, "w");
     if (!fp) {
         printf("Cannot open file for writing: %s\n", path);
         return;
@@ -226,201 +677,994 @@ void edit_file(const char *filename) {
     printf("File updated: %s\n", path);
 }
 
-/* Save: create a commit from everything in .mgit_work/ */
+/* Save: create a commit from everything in .mgit_work/ not ignored */
 void save_commit(const char *msg) {
     ensure_working_dir();
 
-    Commit *new_commit = malloc(sizeof(Commit));
-    new_commit->commit_id = ++repo.commit_count;
-    strncpy(new_commit->message, msg, 255);
-    new_commit->file_count = 0;
-    new_commit->next = repo.head;
-    repo.head = new_commit;
-
-    DIR *dir = opendir(WORKING_DIR);
-    struct dirent *dp;
+    WalkResult tree;
+    if (walk_working_dir(&tree) != 0) {
+        printf("Cannot open %s/\n", WORKING_DIR);
+        return;
+    }
 
-    while ((dp = readdir(dir))) {
-        if (dp->d_name[0] == '.') continue;
+    PendingFile *pending = NULL;
+    int npending = 0, cap = 0;
 
+    for (int t = 0; t < tree.count; t++) {
         char path[512];
-        snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, dp->d_name);
+        snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, tree.files[t]);
+        if (pending_push(&pending, &npending, &cap, path) != 0) break;
+        pending[npending - 1].name = tree.files[t];
+    }
 
-        FILE *fp = fopen(path, "r");
-        if (!fp) continue;
+    FileList files = {0};
+    int new_blobs = snapshot_files(pending, npending, &files, 0);
+    free(pending);
+    walk_result_free(&tree);
 
-        CommitFile *cf = &new_commit->files[new_commit->file_count];
-        strncpy(cf->filename, dp->d_name, MAX_FILENAME);
-        int n = fread(cf->content, 1, MAX_FILE_CONTENT-1, fp);
-        cf->content[n] = '\0';
-        fclose(fp);
+    work_index_prune(&work_index, WORKING_DIR "/");
+    persist_work_index();
 
-        index_file_for_search(path);
-        new_commit->file_count++;
+    Commit *new_commit = publish_commit(msg, &files);
+    free(files.items);
+    if (!new_commit) {
+        printf("Memory allocation failed.\n");
+        return;
     }
 
-    closedir(dir);
     index_commit_message(new_commit->message, new_commit->commit_id);
+    log_commit(new_commit);
+
+    printf("Created commit %d (%d new blobs, %d shared).\n", new_commit->commit_id,
+           new_blobs, new_commit->file_count - new_blobs);
+}
+
+/* Status: compare .mgit_work/ with the head commit. Only files whose
+   stat data changed since they were last hashed are read. */
+void show_status(void) {
+    ensure_working_dir();
+
+    Commit *head = repo.head;
+    FileMap map;
+    if (file_map_build(&map, head) != 0) {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+
+    WalkResult tree;
+    if (walk_working_dir(&tree) != 0) {
+        printf("Cannot open %s/\n", WORKING_DIR);
+        file_map_free(&map);
+        return;
+    }
 
-    printf("Created commit %d.\n", new_commit->commit_id);
+    if (head) {
+        char hex[OBJECT_ID_HEXSZ + 1];
+        object_id_to_hex(&head->hash, hex);
+        printf("On commit %d [%.7s]\n", head->commit_id, hex);
+    } else {
+        printf("No commits yet.\n");
+    }
+
+    int checked = 0, reread = 0, changes = 0;
+
+    for (int t = 0; t < tree.count; t++) {
+        const char *name = tree.files[t];
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, name);
+
+        ObjectId id;
+        if (working_file_id(path, &id, &reread) != 0) continue;
+        checked++;
+
+        int slot = file_map_find(&map, name);
+        if (slot < 0) {
+            printf("  new file:  %s\n", name);
+            changes++;
+            continue;
+        }
+        map.seen[slot] = 1;
+        if (!object_id_equal(&id, &map.sorted[slot]->blob->id)) {
+            printf("  modified:  %s\n", name);
+            changes++;
+        }
+    }
+    walk_result_free(&tree);
+
+    for (int i = 0; i < map.count; i++) {
+        if (map.seen[i]) continue;
+        printf("  deleted:   %s\n", map.sorted[i]->filename);
+        changes++;
+    }
+    file_map_free(&map);
+
+    work_index_prune(&work_index, WORKING_DIR "/");
+    persist_work_index();
+
+    if (changes == 0)
+        printf("Working directory clean.\n");
+    printf("(%d files checked, %d re-read)\n", checked, reread);
+}
+
+
+/* -------- Diff: one side of a file pair -------- */
+/* A blob or a working file, viewed through a span (a blob that had to
+   be loaded is evicted again afterwards). Either may be absent
+   ("/dev/null"). */
+typedef struct DiffSide {
+    Blob *blob;
+    const char *path;
+    Span span;
+    DiffText text;
+    int cached;
+} DiffSide;
+
+static int diff_side_open(DiffSide *s) {
+    memset(&s->text, 0, sizeof(s->text));
+    memset(&s->span, 0, sizeof(s->span));
+    s->span.slot = -1;
+
+    int rc = 0;
+    if (s->blob) {
+        s->cached = s->blob->data || s->blob->map;
+        rc = span_open_blob(s->blob, &s->span);
+    } else if (s->path) {
+        rc = span_open_file(s->path, &s->span);
+    }
+    s->text.data = s->span.data;
+    s->text.size = s->span.size;
+    return rc;
+}
+
+static void diff_side_close(DiffSide *s) {
+    span_close(&s->span);
+    if (s->blob && !s->cached) blob_evict(s->blob);
 }
 
+static void diff_file_pair(const char *name, DiffSide *a, DiffSide *b,
+                           DiffAlgorithm alg, DiffStats *stats) {
+    char a_name[MAX_FILENAME + 8], b_name[MAX_FILENAME + 8];
+    snprintf(a_name, sizeof(a_name), (a->blob || a->path) ? "a/%s" : "/dev/null", name);
+    snprintf(b_name, sizeof(b_name), (b->blob || b->path) ? "b/%s" : "/dev/null", name);
+
+    if (diff_side_open(a) != 0 || diff_side_open(b) != 0) {
+        printf("diff: cannot read %s\n", name);
+    } else {
+        printf("diff --mgit %s %s\n", a_name, b_name);
+        if (diff_print(stdout, a_name, &a->text, b_name, &b->text, alg, stats) != 0)
+            printf("diff: out of memory comparing %s\n", name);
+    }
+    diff_side_close(a);
+    diff_side_close(b);
+}
+
+/* Diff: from_ref against to_ref, or against .mgit_work/ if to_ref is NULL.
+   Files whose content hashes match are skipped without being read; for
+   working files the hash comes from the stat cache. */
+void diff_commits(const char *from_ref, const char *to_ref, DiffAlgorithm alg) {
+    Commit *from = find_commit(resolve_commit_ref(from_ref));
+    Commit *to = to_ref ? find_commit(resolve_commit_ref(to_ref)) : NULL;
+    if (!from || (to_ref && !to)) {
+        printf("Commit %s not found.\n", !from ? from_ref : to_ref);
+        return;
+    }
+
+    FileMap fm, tm = {0};
+    if (file_map_build(&fm, from) != 0 || (to && file_map_build(&tm, to) != 0)) {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+
+    WalkResult tree = {0};
+    int reread = 0;
+    if (!to) {
+        ensure_working_dir();
+        walk_working_dir(&tree);
+    }
+
+    DiffStats stats = {0};
+    int files = 0, skipped = 0;
+    int ai = 0, bi = 0;
+    int b_count = to ? tm.count : tree.count;
+
+    while (ai < fm.count || bi < b_count) {
+        const char *a_name = ai < fm.count ? fm.sorted[ai]->filename : NULL;
+        const char *b_name = bi < b_count ? (to ? tm.sorted[bi]->filename : tree.files[bi]) : NULL;
+        int c = !a_name ? 1 : !b_name ? -1 : strcmp(a_name, b_name);
+
+        DiffSide a = {0}, b = {0};
+        const char *name = c <= 0 ? a_name : b_name;
+        char path[512];
+
+        if (c <= 0) a.blob = fm.sorted[ai++]->blob;
+        if (c >= 0) {
+            if (to) {
+                b.blob = tm.sorted[bi++]->blob;
+            } else {
+                snprintf(path, sizeof(path), "%s/%s", WORKING_DIR, tree.files[bi++]);
+                b.path = path;
+            }
+        }
+
+        if (a.blob && (b.blob || b.path)) {
+            ObjectId id = b.blob ? b.blob->id : (ObjectId){{0}};
+            if (b.path && working_file_id(b.path, &id, &reread) != 0) continue;
+            if (object_id_equal(&a.blob->id, &id)) {
+                skipped++;
+                continue;
+            }
+        }
+
+        diff_file_pair(name, &a, &b, alg, &stats);
+        files++;
+    }
+
+    walk_result_free(&tree);
+    file_map_free(&fm);
+    if (to) file_map_free(&tm);
+    if (!to) persist_work_index();
+
+    printf("%d file%s changed, %d insertion%s(+), %d deletion%s(-)",
+           files, files == 1 ? "" : "s",
+           stats.added, stats.added == 1 ? "" : "s",
+           stats.removed, stats.removed == 1 ? "" : "s");
+    if (stats.binary) printf(", %d binary", stats.binary);
+    printf("\n(%d unchanged file%s skipped by hash", skipped, skipped == 1 ? "" : "s");
+    if (!to) printf(", %d re-read", reread);
+    printf(")\n");
+}
 
 /* =============== REPOSITORY FUNCTIONS =================== */
 
+/* What replay needs to know ahead: which logged commits a later
+   record deletes again. GC may have swept their objects already; the
+   delete drops them anyway, so they must not end the log. */
+typedef struct ReplayPlan {
+    int *ids;                     // commit id of each record
+    int *parents;                 // parent id of each commit record
+    unsigned char *types;
+    unsigned char *doomed;        // commit record undone by a later delete
+    int count;
+    int cap;
+    int next;                     // record being replayed
+} ReplayPlan;
+
+typedef struct PlanEntry {
+    int id;
+    int record;
+} PlanEntry;
+
+static int cmp_plan_entry(const void *a, const void *b) {
+    const PlanEntry *x = (const PlanEntry *)a, *y = (const PlanEntry *)b;
+    if (x->id != y->id) return x->id < y->id ? -1 : 1;
+    return x->record < y->record ? -1 : x->record > y->record;
+}
+
+static int plan_log_record(int type, const unsigned char *p, size_t len, void *ctx) {
+    ReplayPlan *plan = (ReplayPlan *)ctx;
+    if (plan->count == plan->cap) {
+        int cap = plan->cap ? plan->cap * 2 : 64;
+        int *ids = realloc(plan->ids, (size_t)cap * sizeof(int));
+        if (!ids) return -1;
+        plan->ids = ids;
+        int *parents = realloc(plan->parents, (size_t)cap * sizeof(int));
+        if (!parents) return -1;
+        plan->parents = parents;
+        unsigned char *types = realloc(plan->types, (size_t)cap);
+        if (!types) return -1;
+        plan->types = types;
+        plan->cap = cap;
+    }
+    plan->ids[plan->count] = repo_store_log_commit_id(p, len);
+    plan->parents[plan->count] = type == LOG_COMMIT && len >= 8
+        ? repo_store_log_commit_id(p + 4, len - 4) : 0;
+    plan->types[plan->count] = (unsigned char)type;
+    plan->count++;
+    return 0;
+}
+
+/* Mark the commit records whose next record for the same id is a delete
+   (ids are reused once the newest commit is deleted) */
+static void plan_replay(ReplayPlan *plan) {
+    if (wal_replay(plan_log_record, plan) < 0 || plan->count == 0) return;
+
+    PlanEntry *entries = malloc((size_t)plan->count * sizeof(PlanEntry));
+    plan->doomed = calloc((size_t)plan->count, 1);
+    if (!entries || !plan->doomed) {
+        free(entries);
+        return;
+    }
+    for (int i = 0; i < plan->count; i++)
+        entries[i] = (PlanEntry){ plan->ids[i], i };
+    qsort(entries, (size_t)plan->count, sizeof(PlanEntry), cmp_plan_entry);
+
+    for (int i = 0; i + 1 < plan->count; i++) {
+        const PlanEntry *e = &entries[i], *later = &entries[i + 1];
+        if (e->id == later->id && plan->types[e->record] == LOG_COMMIT &&
+            plan->types[later->record] == LOG_DELETE)
+            plan->doomed[e->record] = 1;
+    }
+    free(entries);
+}
+
+static void plan_free(ReplayPlan *plan) {
+    free(plan->ids);
+    free(plan->parents);
+    free(plan->types);
+    free(plan->doomed);
+    memset(plan, 0, sizeof(*plan));
+}
+
+/* Apply one WAL record on top of the loaded table. Records already in
+   the table (crash between checkpoint and log reset) are skipped. */
+static int replay_log_record(int type, const unsigned char *p, size_t len, void *ctx) {
+    ReplayPlan *plan = (ReplayPlan *)ctx;
+    int record = plan->next++;
+
+    if (type == LOG_COMMIT) {
+        /* Deleted again later in the log: nothing to bring back, but
+           its id stays used, as it did in the session that made it */
+        if (plan->doomed && record < plan->count && plan->doomed[record]) {
+            if (plan->ids[record] > repo.commit_count)
+                repo.commit_count = plan->ids[record];
+            return 0;
+        }
+
+        Commit *c = repo_store_decode_commit(p, len, &repo.arena);
+        if (!c) return -1;
+
+        /* Objects are synced per group, after the record is written: a
+           record whose objects did not survive ends the log here */
+        for (int i = 0; i < c->file_count; i++) {
+            if (!object_store_exists(&c->files[i].blob->id)) {
+                release_commit(c);
+                return -1;
+            }
+        }
+        if (find_commit(c->commit_id)) {
+            release_commit(c);
+            return 0;
+        }
+        link_commit(c);
+        return 0;
+    }
+    if (type == LOG_DELETE && len == 4) {
+        int cid = repo_store_log_commit_id(p, len);
+        Commit *c = find_commit(cid);
+        if (c) {
+            unlink_commit(c);
+            release_commit(c);
+            return 0;
+        }
+
+        /* A commit skipped above: relink the one made on top of it to
+           its parent, as unlink_commit() did when it was deleted */
+        for (int i = record - 1; plan->doomed && i >= 0; i--) {
+            if (plan->ids[i] != cid || plan->types[i] != LOG_COMMIT) continue;
+            for (Commit *n = repo.head; n; n = n->next) {
+                if (n->parent_id == cid) {
+                    n->parent_id = plan->parents[i];
+                    break;
+                }
+            }
+            break;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+/* Flush pending WAL records; the next load replays them */
+void close_repository(void) {
+    if (object_store_sync() != 0 || wal_sync() != 0)
+        printf("Warning: could not sync %s\n", REPO_WAL);
+    wal_close();
+    span_cache_clear();
+}
+
 void init_repository(void) {
+    gc_cancel();                                  // holds commit ids of the old state
+    staging_clear(&staging);                      // holds blobs of the old store
+
+    /* Dropping the arena frees every commit record at once */
+    arena_free_all(&repo.arena);
+    commit_index_clear(&repo.index);
+    commit_graph_clear(&repo.graph);
+    work_index_clear(&work_index);
     repo.head = NULL;
     repo.commit_count = 0;
+
+    if (repo_store_ensure_layout() != 0) {
+        object_store_init(NULL);
+        printf("Repository has been initialized (in memory only).\n");
+        return;
+    }
+    object_store_init(REPO_OBJECTS_DIR);
+    repo_store_load_config(&repo_config);
+    if (object_store_set_compression(repo_config.compression_level,
+                                     repo_config.compression_dict) != 0)
+        printf("Warning: compression dictionary %08x is missing, new objects are compressed without it.\n",
+               (unsigned)repo_config.compression_dict);
+    if (work_index_load(&work_index, REPO_INDEX) < 0)
+        printf("Warning: %s is corrupt, changed files will be re-read.\n", REPO_INDEX);
+
+    int loaded = repo_store_load(&repo);
+    for (Commit *c = repo.head; c; c = c->next) {
+        compute_commit_hash(c);
+        commit_index_insert(&repo.index, c);
+    }
+
+    /* The graph is written with the table; rebuild it if they disagree */
+    int rows = commit_graph_load(&repo.graph, REPO_COMMIT_GRAPH);
+    const GraphRow *tip = commit_graph_tip(&repo.graph);
+    if (rows != (int)repo.index.count ||
+        (repo.head && (!tip || tip->commit_id != repo.head->commit_id ||
+                       !object_id_equal(&tip->hash, &repo.head->hash)))) {
+        commit_graph_clear(&repo.graph);
+        if (commit_graph_rebuild(&repo.graph, repo.head) == 0 && loaded >= 0)
+            commit_graph_write(&repo.graph, REPO_COMMIT_GRAPH);
+    }
+
+    /* Changes made after the table was last written live in the WAL */
+    int replayed = -1;
+    if (repo_store_open_log() == 0) {
+        ReplayPlan plan = {0};
+        plan_replay(&plan);
+        replayed = wal_replay(replay_log_record, &plan);
+        plan_free(&plan);
+    }
+    if (replayed < 0) {
+        printf("Warning: cannot open %s, commits are written to the table directly.\n", REPO_WAL);
+    } else if (replayed > 0) {
+        printf("Recovered %d change(s) from %s.\n", replayed, REPO_WAL);
+        if (loaded >= 0 && repo_store_checkpoint(&repo) != 0)
+            printf("Warning: could not write %s\n", REPO_COMMITS);
+        loaded = (int)repo.index.count;
+    }
+
+    if (loaded < 0) {
+        printf("Warning: %s is corrupt, some commits could not be loaded.\n", REPO_COMMITS);
+    } else if (loaded > 0) {
+        printf("Repository loaded from %s/ (%d commits).\n", REPO_DIR, loaded);
+        return;
+    }
     printf("Repository has been initialized.\n");
 }
 
-void add_file(char *filename) {
-    if (!filename || strlen(filename) == 0) {
-        printf("Invalid filename.\n");
+/* Put a snapshotted file in the staging area under name. 1 if it is
+   new there, 0 if it replaced an earlier add, -1 if memory ran out (the
+   blob is then released). */
+static int stage_pending(PendingFile *pf, const char *name) {
+    int added = 0;
+    size_t len = strlen(name) + 1;
+    StagedFile *sf = staging_insert(&staging, pf->path, &added);
+    char *copy = sf ? malloc(len) : NULL;
+    if (!copy) {
+        blob_release(pf->blob);
+        return -1;
+    }
+    memcpy(copy, name, len);
+    free(sf->name);
+    sf->name = copy;
+    blob_release(sf->blob);
+    sf->blob = pf->blob;
+    sf->st = pf->st;
+    sf->is_new = pf->is_new;
+    return added;
+}
+
+/* Stage every file below dir (normalized) that its .mgitignore lets
+   through, named by its path inside dir. The tree is listed on the
+   worker pool, then all files go through one snapshot run, so reading,
+   hashing, storing and tokenizing are spread over the pool too, and
+   the search index takes the new documents as one batch. */
+static void add_directory(const char *dir) {
+    IgnoreRules rules;
+    WalkResult tree;
+    if (ignore_load(&rules, dir) != 0) {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    int rc = tree_walk(dir, ignore_hook, &rules, &tree);
+    ignore_free(&rules);
+    if (rc != 0) {
+        printf("Error: cannot read directory '%s'.\n", dir);
         return;
     }
 
-    char fullpath[MAX_FILENAME];
+    PendingFile *pending = NULL;
+    int npending = 0, cap = 0, too_long = 0;
+    const char *sep = dir[1] ? "/" : "";          // dir may be "/"
 
-    if (filename[0] == '/' || filename[0] == '\\') {
-        strncpy(fullpath, filename, sizeof(fullpath) - 1);
-        fullpath[sizeof(fullpath) - 1] = '\0';
-    } else {
-        char cwd[1024];
-        getcwd(cwd, sizeof(cwd));
-        snprintf(fullpath, sizeof(fullpath), "%s/%s", cwd, filename);
+    for (int t = 0; t < tree.count; t++) {
+        char path[STAGING_PATH_MAX];
+        int n = snprintf(path, sizeof(path), "%s%s%s", dir, sep, tree.files[t]);
+        if (n < 0 || (size_t)n >= sizeof(path)) {
+            too_long++;
+            continue;
+        }
+        if (pending_push(&pending, &npending, &cap, path) != 0) break;
+        pending[npending - 1].name = tree.files[t];
+        pending[npending - 1].staged = staging_find(&staging, path);
     }
 
-    FILE *fp = fopen(fullpath, "r");
-    if (!fp) {
-        printf("Error: File '%s' does not exist.\n", fullpath);
+    snapshot_files(pending, npending, NULL, 1);
+    persist_work_index();
+
+    const char **docs = npending ? malloc((size_t)npending * sizeof(char *)) : NULL;
+    int added = 0, updated = 0, unchanged = 0, ndocs = 0;
+
+    for (int i = 0; i < npending; i++) {
+        PendingFile *pf = &pending[i];
+        if (!pf->blob) continue;
+
+        /* Inserts may move the entries: look each one up afresh */
+        StagedFile *sf = staging_find(&staging, pf->path);
+        if (sf && sf->blob == pf->blob) {
+            blob_release(pf->blob);
+            unchanged++;
+            continue;
+        }
+
+        int rc = stage_pending(pf, pf->name);
+        if (rc < 0) {
+            printf("Memory allocation failed.\n");
+            break;
+        }
+        if (rc == 0) {
+            updated++;
+            continue;
+        }
+        added++;
+        if (docs) docs[ndocs++] = pf->path;
+    }
+    add_documents_to_search_engine(docs, ndocs);
+
+    printf("Added %d files from %s (%d updated, %d already staged, %d ignored",
+           added, dir, updated, unchanged, tree.ignored);
+    if (too_long + tree.errors) printf(", %d unreadable", too_long + tree.errors);
+    printf(").\n");
+
+    free(docs);
+    free(pending);
+    walk_result_free(&tree);
+}
+
+/* Stage a file: it is read, stored and indexed now, once. Adding it
+   again only redoes that if the file changed in between. A directory
+   stages the files below it. */
+void add_file(char *filename) {
+    if (!filename || strlen(filename) == 0) {
+        printf("Invalid filename.\n");
         return;
     }
-    fclose(fp);
 
-    File *new_file = (File *)malloc(sizeof(File));
-    if (!new_file) {
-        printf("Memory allocation failed.\n");
+    char path[STAGING_PATH_MAX];
+    struct stat st;
+    if (staging_normalize(filename, path, sizeof(path)) != 0) {
+        printf("Error: path too long: %s\n", filename);
+        return;
+    }
+    if (stat(path, &st) != 0 || !(S_ISREG(st.st_mode) || S_ISDIR(st.st_mode))) {
+        printf("Error: File '%s' does not exist.\n", path);
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        add_directory(path);
         return;
     }
 
-    strncpy(new_file->filename, fullpath, sizeof(new_file->filename) - 1);
-    new_file->filename[sizeof(new_file->filename) - 1] = '\0';
+    StagedFile *sf = staging_find(&staging, path);
+    if (sf && staging_unchanged(sf, &st)) {
+        printf("File already staged: %s\n", path);
+        return;
+    }
 
-    new_file->next = index_head;
-    index_head = new_file;
+    PendingFile pf;
+    memset(&pf, 0, sizeof(pf));
+    snprintf(pf.path, sizeof(pf.path), "%s", path);
+    pf.job = -1;
+    snapshot_files(&pf, 1, NULL, 1);
+    persist_work_index();
+    if (!pf.blob) return;
 
-    printf("File added: %s\n", new_file->filename);
+    int added = stage_pending(&pf, strrchr(path, '/') + 1);
+    if (added < 0) {
+        printf("Memory allocation failed.\n");
+        return;
+    }
 
-    index_file_for_search(new_file->filename);
-    add_document_to_search_engine(new_file->filename);
+    printf(added ? "File added: %s\n" : "File updated: %s\n", path);
+    if (added) add_document_to_search_engine(path);
 }
 
 /* Create a real snapshot commit from staged files */
 void commit_staged(char *msg) {
-    if (!index_head) {
+    if (staging.count == 0) {
         printf("No files to commit.\n");
         return;
     }
 
-    Commit *new_commit = malloc(sizeof(Commit));
-    new_commit->commit_id = ++repo.commit_count;
-    strncpy(new_commit->message, msg, 255);
+    PendingFile *pending = NULL;
+    int npending = 0, cap = 0;
 
-    new_commit->file_count = 0;
-    new_commit->next = repo.head;
-    repo.head = new_commit;
+    for (int i = 0; i < staging.count; i++) {
+        if (pending_push(&pending, &npending, &cap, staging.entries[i].path) != 0) break;
+        pending[npending - 1].staged = &staging.entries[i];
+        pending[npending - 1].name = staging.entries[i].name;
+    }
 
-    printf("Commit %d created.\n", new_commit->commit_id);
+    FileList files = {0};
+    int new_blobs = snapshot_files(pending, npending, &files, 1);
+    free(pending);
+    persist_work_index();
 
-    File *f = index_head;
-    while (f) {
-        CommitFile *cf = &new_commit->files[new_commit->file_count];
+    Commit *new_commit = publish_commit(msg, &files);
+    free(files.items);
+    if (!new_commit) {
+        printf("Memory allocation failed.\n");
+        return;
+    }
 
-        const char *base = strrchr(f->filename, '/');
-        base = base ? base + 1 : f->filename;
+    printf("Commit %d created (%d new blobs, %d shared).\n", new_commit->commit_id,
+           new_blobs, new_commit->file_count - new_blobs);
 
-        strncpy(cf->filename, base, MAX_FILENAME-1);
+    index_commit_message(new_commit->message, new_commit->commit_id);
+    log_commit(new_commit);
+    staging_clear(&staging);
+}
 
-        FILE *fp = fopen(f->filename, "r");
-        if (fp) {
-            int n = fread(cf->content, 1, MAX_FILE_CONTENT-1, fp);
-            cf->content[n] = '\0';
-            fclose(fp);
-        }
 
-        index_file_for_search(f->filename);
+void view_commit(int cid) {
+    Commit *temp = find_commit(cid);
+    if (!temp) {
+        printf("Commit %d not found.\n", cid);
+        return;
+    }
 
-        new_commit->file_count++;
-        f = f->next;
+    char hex[OBJECT_ID_HEXSZ + 1];
+    object_id_to_hex(&temp->hash, hex);
+
+    printf("\n=== Commit %d ===\n", temp->commit_id);
+    printf("Hash: %s\n", hex);
+    printf("Message: %s\n", temp->message);
+    printf("Files in this commit: %d\n\n", temp->file_count);
+
+    for (int i = 0; i < temp->file_count; i++) {
+        CommitFile *cf = &temp->files[i];
+
+        printf(" --- File #%d ---\n", i + 1);
+        printf("Filename: %s\n", cf->filename);
+        printf("Content:\n");
+        printf("----------------------------------------\n");
+        ViewState vs = { 1, 0 };
+        Span span;
+        int rc = span_open_blob(cf->blob, &span);
+        if (rc == 0) {
+            sink_to_stdout(span.data, span.size, &vs);
+            span_close(&span);
+        }
+        if (vs.binary)
+            printf("(binary file, %zu bytes)", cf->blob->size);
+        else if (rc != 0)
+            printf("(object missing)");
+        printf("\n----------------------------------------\n\n");
     }
+}
 
-    index_commit_message(new_commit->message, new_commit->commit_id);
+void delete_commit(int cid) {
+    Commit *temp = find_commit(cid);
+    if (temp == NULL) {
+        printf("Commit not found.\n");
+        return;
+    }
+
+    unlink_commit(temp);
+    release_commit(temp);
+    if (repo_store_log_delete(&repo, cid) != 0)
+        printf("Warning: could not write %s\n", REPO_WAL);
+    printf("Commit %d deleted.\n", cid);
 
-    while (index_head) {
-        File *del = index_head;
-        index_head = index_head->next;
-        free(del);
+    gc_start();                                   // reclaim its objects in the background
+}
+
+/* Streams the log a page at a time; nothing is built up front */
+void view_log(int max_entries) {
+    LogCursor cur = log_cursor_begin();
+    if (cur.next_id == 0) {
+        printf("No commits yet.\n");
+        return;
     }
+
+    LogEntry page[LOG_PAGE_SIZE];
+    int shown = 0, n;
+    while ((max_entries <= 0 || shown < max_entries) &&
+           (n = log_next_page(&cur, page, LOG_PAGE_SIZE)) > 0) {
+        for (int i = 0; i < n && (max_entries <= 0 || shown < max_entries); i++, shown++) {
+            char hex[OBJECT_ID_HEXSZ + 1];
+            object_id_to_hex(&page[i].hash, hex);
+            printf("Commit %d [%.7s]: %s\n",
+                   page[i].commit_id, hex, page[i].message);
+        }
+    }
+    if (cur.next_id && shown < log_count())
+        printf("... %d older commits (use 'log <count>' to see more)\n", log_count() - shown);
 }
 
+void check_ancestry(const char *ancestor_ref, const char *descendant_ref) {
+    int a = resolve_commit_ref(ancestor_ref);
+    int d = resolve_commit_ref(descendant_ref);
 
-void view_commit(int cid) {
-    Commit *temp = repo.head;
-
-    while (temp) {
-        if (temp->commit_id == cid) {
-            printf("\n=== Commit %d ===\n", temp->commit_id);
-            printf("Message: %s\n", temp->message);
-            printf("Files in this commit: %d\n\n", temp->file_count);
-
-            for (int i = 0; i < temp->file_count; i++) {
-                CommitFile *cf = &temp->files[i];
-
-                printf(" --- File #%d ---\n", i + 1);
-                printf("Filename: %s\n", cf->filename);
-                printf("Content:\n");
-                printf("----------------------------------------\n");
-                printf("%s\n", cf->content);
-                printf("----------------------------------------\n\n");
-            }
+    int rc = commit_graph_is_ancestor(&repo.graph, a, d);
+    if (rc < 0)
+        printf("Commit not found.\n");
+    else
+        printf("Commit %d is %san ancestor of commit %d.\n", a, rc ? "" : "not ", d);
+}
 
-            return;
+/* =============== LOG PAGES =================== */
+
+static void fill_log_entry(LogEntry *e, const GraphRow *row) {
+    e->commit_id = row->commit_id;
+    e->hash = row->hash;
+    e->timestamp = row->timestamp;
+    e->message = row->message;
+}
+
+LogCursor log_cursor_begin(void) {
+    const GraphRow *tip = commit_graph_tip(&repo.graph);
+    LogCursor cur = { tip ? tip->commit_id : 0 };
+    return cur;
+}
+
+/* Walks the commit-graph along parent links */
+int log_next_page(LogCursor *cur, LogEntry *out, int max) {
+    const GraphRow *row = cur->next_id ? commit_graph_find(&repo.graph, cur->next_id) : NULL;
+    int n = 0;
+    for (; row && n < max; row = commit_graph_parent(&repo.graph, row))
+        fill_log_entry(&out[n++], row);
+    cur->next_id = row ? row->commit_id : 0;
+    return n;
+}
+
+int log_count(void) {
+    return repo.graph.count;
+}
+
+/* History is linear, so the parent walk from the tip visits the graph
+   rows in descending id order: position p is row count-1-p (O(1)) */
+int log_entry_at(int position, LogEntry *out) {
+    if (position < 0 || position >= repo.graph.count) return -1;
+    fill_log_entry(out, &repo.graph.rows[repo.graph.count - 1 - position]);
+    return 0;
+}
+
+/* =============== MAINTENANCE =================== */
+
+typedef struct RepackItem {
+    const char *filename;
+    int commit_id;
+    Blob *blob;
+} RepackItem;
+
+/* Group versions by file name, newest first inside each group */
+static int cmp_repack_item(const void *a, const void *b) {
+    const RepackItem *ra = (const RepackItem *)a;
+    const RepackItem *rb = (const RepackItem *)b;
+    int c = strcmp(ra->filename, rb->filename);
+    if (c != 0) return c;
+    return rb->commit_id - ra->commit_id;
+}
+
+/* Rebuild the pack from every blob reachable from the history (or only
+   those already packed), stored as per-file delta chains, then drop the
+   now-redundant loose objects */
+int repack_objects(int packed_only, PackStats *stats) {
+    size_t n = 0;
+    for (Commit *c = repo.head; c; c = c->next)
+        n += (size_t)c->file_count;
+
+    RepackItem *items = n ? malloc(n * sizeof(RepackItem)) : NULL;
+    Blob **blobs = n ? malloc(n * sizeof(Blob *)) : NULL;
+    int *chain = n ? malloc(n * sizeof(int)) : NULL;
+    if (n && (!items || !blobs || !chain)) {
+        free(items); free(blobs); free(chain);
+        return -1;
+    }
+
+    size_t k = 0;
+    for (Commit *c = repo.head; c; c = c->next) {
+        for (int i = 0; i < c->file_count; i++) {
+            if (packed_only && !pack_contains(&c->files[i].blob->id)) continue;
+            items[k].filename = c->files[i].filename;
+            items[k].commit_id = c->commit_id;
+            items[k].blob = c->files[i].blob;
+            items[k].blob->mark = 0;
+            k++;
         }
-        temp = temp->next;
+    }
+    n = k;
+    if (n) qsort(items, n, sizeof(RepackItem), cmp_repack_item);
+
+    /* Each blob is packed once, in the first chain that uses it */
+    int count = 0, chain_id = -1;
+    for (size_t i = 0; i < n; i++) {
+        if (i == 0 || strcmp(items[i].filename, items[i - 1].filename) != 0)
+            chain_id++;
+        if (items[i].blob->mark) continue;
+        items[i].blob->mark = 1;
+        blobs[count] = items[i].blob;
+        chain[count] = chain_id;
+        count++;
     }
 
-    printf("Commit %d not found.\n", cid);
+    int rc = object_store_repack(blobs, chain, count, stats);
+    free(items);
+    free(blobs);
+    free(chain);
+    return rc;
 }
 
-void delete_commit(int cid) {
-    Commit *temp = repo.head, *prev = NULL;
-    while (temp != NULL && temp->commit_id != cid) {
-        prev = temp;
-        temp = temp->next;
-    }
-    if (temp == NULL) {
-        printf("Commit not found.\n");
+void mark_staged_blobs(unsigned epoch) {
+    for (int i = 0; i < staging.count; i++)
+        staging.entries[i].blob->reached = epoch;
+}
+
+/* GC: finish the running cycle and report. Cycles that finished in the
+   background (after a delete) and were not reported yet are reported
+   instead of running another. */
+void collect_garbage(void) {
+    const GcReport *r = gc_last_report();
+    if (!gc_active() && (!r->finished || r->reported))
+        gc_start();
+    while (gc_step(GC_STEP_BUDGET))
+        ;
+
+    printf("Marked %d blobs (%zu bytes) reachable from %d commits.\n",
+           r->live_blobs, r->live_bytes, r->commits);
+    printf("Removed %d unreachable loose objects and %d stale temp files (%zu bytes).\n",
+           r->loose_removed, r->temp_removed, r->loose_bytes);
+    if (r->pack_dead)
+        printf("Dropped %d unreachable objects from the pack (%zu bytes).\n",
+               r->pack_dead, r->pack_bytes);
+    printf("Reclaimed %zu bytes in %d cycle%s, %d step%s.\n", r->loose_bytes + r->pack_bytes,
+           r->cycles, r->cycles == 1 ? "" : "s", r->steps, r->steps == 1 ? "" : "s");
+    gc_ack_report();
+}
+
+void repack_repository(void) {
+    PackStats stats = {0};
+    if (repack_objects(0, &stats) != 0) {
+        printf("Repack failed.\n");
         return;
     }
-    if (prev == NULL)
-        repo.head = temp->next;
+    printf("Packed %d objects (%d as deltas): %zu bytes -> %zu bytes.\n",
+           stats.objects, stats.deltas, stats.raw_bytes, stats.pack_bytes);
+}
+
+/* =============== COMPRESSION =================== */
+
+#define DICT_SAMPLE_MAX   (16 * 1024)           // bytes taken from the start of each file
+#define DICT_SAMPLE_TOTAL (8 * 1024 * 1024)
+
+static void show_compression(void) {
+    uint32_t dict = 0;
+    int level = object_store_compression(&dict);
+    if (level == 0)
+        printf("Compression: off (new objects are stored raw).\n");
+    else if (dict)
+        printf("Compression: level %d with dictionary %08x.\n", level, (unsigned)dict);
     else
-        prev->next = temp->next;
+        printf("Compression: level %d, no dictionary.\n", level);
+}
 
-    free(temp);
-    printf("Commit %d deleted.\n", cid);
+/* Set the level for objects written from now on (stored objects keep
+   theirs), or just show it if arg is NULL */
+void set_compression(const char *arg) {
+    if (arg) {
+        char *end;
+        long level = strtol(arg, &end, 10);
+        if (end == arg || *end != '\0' || level < 0 || level > CODEC_MAX_LEVEL) {
+            printf("Compression level must be between 0 (off) and %d.\n", CODEC_MAX_LEVEL);
+            return;
+        }
+        repo_config.compression_level = (int)level;
+        object_store_set_compression((int)level, repo_config.compression_dict);
+        if (repo_store_save_config(&repo_config) != 0)
+            printf("Warning: could not write %s\n", REPO_CONFIG);
+    }
+    show_compression();
 }
 
-void view_log(void) {
-    Commit *temp = repo.head;
-    if (!temp) {
-        printf("No commits yet.\n");
+typedef struct SamplePool {
+    unsigned char *data;
+    size_t len;
+    size_t file_start;            // where the current file's sample began
+} SamplePool;
+
+static int collect_sample(const unsigned char *chunk, size_t len, void *ctx) {
+    SamplePool *pool = ctx;
+    size_t room = pool->file_start + DICT_SAMPLE_MAX - pool->len;
+    if (len > room) len = room;
+    memcpy(pool->data + pool->len, chunk, len);
+    pool->len += len;
+    return pool->len == pool->file_start + DICT_SAMPLE_MAX;   // enough of this file
+}
+
+/* Train a dictionary on the head commit's files and use it for new
+   objects. It pays off for many small, similar files, which otherwise
+   compress poorly because each is compressed on its own. */
+void train_compression_dict(void) {
+    Commit *head = repo.head;
+    if (!head || head->file_count == 0) {
+        printf("No committed files to train on.\n");
         return;
     }
-    while (temp) {
-        printf("Commit %d: %s\n",
-               temp->commit_id, temp->message);
-        temp = temp->next;
+
+    SamplePool pool = { malloc(DICT_SAMPLE_TOTAL), 0, 0 };
+    const unsigned char **samples = malloc((size_t)head->file_count * sizeof(*samples));
+    size_t *sizes = malloc((size_t)head->file_count * sizeof(size_t));
+    unsigned char *dict = malloc(CODEC_DICT_MAX);
+    if (!pool.data || !samples || !sizes || !dict) {
+        printf("Error: out of memory.\n");
+        goto done;
+    }
+
+    int count = 0;
+    for (int i = 0; i < head->file_count && pool.len + DICT_SAMPLE_MAX <= DICT_SAMPLE_TOTAL; i++) {
+        Blob *b = head->files[i].blob;
+        int cached = b->data != NULL;
+        pool.file_start = pool.len;
+        if (blob_stream(b, collect_sample, &pool) < 0) pool.len = pool.file_start;
+        if (!cached) blob_evict(b);
+        if (pool.len == pool.file_start) continue;
+
+        sizes[count++] = pool.len - pool.file_start;
+    }
+    size_t off = 0;
+    for (int i = 0; i < count; i++) {
+        samples[i] = pool.data + off;
+        off += sizes[i];
+    }
+
+    size_t dict_len = codec_train_dict(samples, sizes, count, dict, CODEC_DICT_MAX);
+    uint32_t id = 0;
+    if (dict_len == 0) {
+        printf("Not enough data to train a dictionary (%zu bytes in %d files).\n", pool.len, count);
+        goto done;
+    }
+    if (object_store_add_dict(dict, dict_len, &id) != 0) {
+        printf("Error: cannot store the dictionary in %s/dict/\n", REPO_OBJECTS_DIR);
+        goto done;
+    }
+
+    /* What the dictionary buys on the samples themselves */
+    int level = repo_config.compression_level > 0 ? repo_config.compression_level : CODEC_DEFAULT_LEVEL;
+    CodecDict cd = { id, dict, dict_len };
+    CodecScratch *scratch = codec_scratch_new();
+    unsigned char *out = malloc(codec_bound(DICT_SAMPLE_MAX));
+    size_t plain = 0, with_dict = 0;
+    for (int i = 0; scratch && out && i < count; i++) {
+        plain += codec_compress(scratch, samples[i], sizes[i], out, level, NULL);
+        with_dict += codec_compress(scratch, samples[i], sizes[i], out, level, &cd);
     }
+    codec_scratch_free(scratch);
+    free(out);
+
+    repo_config.compression_dict = id;
+    object_store_set_compression(repo_config.compression_level, id);
+    if (repo_store_save_config(&repo_config) != 0)
+        printf("Warning: could not write %s\n", REPO_CONFIG);
+
+    printf("Trained dictionary %08x (%zu bytes) on %d files (%zu bytes).\n",
+           (unsigned)id, dict_len, count, pool.len);
+    printf("Sampled files compress to %zu bytes with it, %zu without.\n", with_dict, plain);
+    if (repo_config.compression_level == 0)
+        printf("Compression is off; enable it with 'compression <level>' to use the dictionary.\n");
+
+done:
+    free(pool.data);
+    free(samples);
+    free(sizes);
+    free(dict);
 }
@@ -5,57 +5,104 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Max file content stored per commit */
-#define MAX_FILE_CONTENT     50000        // 50 KB snapshot
-#define MAX_FILENAME         200
-#define MAX_FILES_PER_COMMIT 50
-
-/* -------- Staged File (Linked List) -------- */
-/* Here filename will store the FULL PATH (absolute/relative) */
-typedef struct File {
-    char filename[MAX_FILENAME];  // full path as added
-    struct File *next;
-} File;
+#include "object_store.h"
+#include "arena.h"
+#include "commit_index.h"
+#include "commit_graph.h"
+#include "diff.h"
+
+#define MAX_FILENAME         200          // staged path buffer
 
 /* -------- File Snapshot Stored in Commit -------- */
-/* Here filename will store ONLY the basename, e.g. "main.c" */
+/* Here filename will store ONLY the basename, e.g. "main.c".
+   The content lives once in the object store and is shared by
+   every commit that has the same bytes. */
 typedef struct CommitFile {
-    char filename[MAX_FILENAME];          // just the file name
-    char content[MAX_FILE_CONTENT];       // full snapshot
+    const char *filename;                 // just the file name (arena)
+    Blob *blob;                           // shared snapshot
 } CommitFile;
 
 /* -------- Commit Structure -------- */
+/* Variable-length record: the Commit, its message and its files array
+   are all carved out of the repository arena, sized to the real data. */
 typedef struct Commit {
     int commit_id;
-    char message[256];
+    ObjectId hash;                        // digest of the commit record
+    int parent_id;                        // 0 for the root commit
+    long timestamp;                       // creation time (seconds)
+    const char *message;
 
-    CommitFile files[MAX_FILES_PER_COMMIT];
+    CommitFile *files;                    // file_count entries
     int file_count;
 
-    struct Commit *next;
+    struct Commit *next;                  // older commit (parent)
+    struct Commit *prev;                  // newer commit (only child)
 } Commit;
 
 /* -------- Repository Wrapper -------- */
 typedef struct Repository {
     Commit *head;
     int commit_count;
+    Arena arena;                          // owns every Commit record
+    CommitIndex index;                    // id / hash-prefix lookup
+    CommitGraph graph;                    // parents + generations for log/ancestry
 } Repository;
 
 /* -------- Global Variables (defined in minigit.c) -------- */
 extern Repository repo;
-extern File *index_head;
 
 /* -------- API Functions -------- */
 void init_repository(void);
-void add_file(char *filename);
+void close_repository(void);                   // flush the write-ahead log
+void add_file(char *filename);                 // a directory adds its whole tree
 void commit_staged(char *msg);
 void view_commit(int cid);
 void delete_commit(int cid);
-void view_log(void);
+void view_log(int max_entries);               // 0: whole history
+void check_ancestry(const char *ancestor_ref, const char *descendant_ref);
+
+/* -------- Log pages: commit summaries, newest first -------- */
+/* Served from the commit-graph; a cursor names the next commit to
+   return, so it stays valid while new commits are added on top. */
+#define LOG_PAGE_SIZE 50
+
+typedef struct LogEntry {
+    int commit_id;
+    ObjectId hash;
+    long timestamp;
+    const char *message;          // valid until the repository is reset
+} LogEntry;
+
+typedef struct LogCursor {
+    int next_id;                  // 0 once the root has been returned
+} LogCursor;
+
+LogCursor log_cursor_begin(void);
+int log_next_page(LogCursor *cur, LogEntry *out, int max);    // entries written
+int log_count(void);
+int log_entry_at(int position, LogEntry *out);                 // 0 = newest; 0 on success
+
+/* Commit lookup (O(1) by id, O(log n) by abbreviated hash) */
+Commit *find_commit(int cid);
+Commit *find_commit_by_prefix(const char *hex_prefix);
+int resolve_commit_ref(const char *ref);      // id or hash prefix -> id, -1 if none
+void compute_commit_hash(Commit *c);
 
 /* New simple VCS helpers */
 void checkout_commit(int cid);
 void edit_file(const char *filename);
 void save_commit(const char *msg);
+void show_status(void);                       // working dir vs head commit
+void diff_commits(const char *from_ref, const char *to_ref,   // to_ref NULL: .mgit_work/
+                  DiffAlgorithm alg);
+
+/* Maintenance */
+struct PackStats;
+void repack_repository(void);
+int  repack_objects(int packed_only, struct PackStats *stats);   // 0 on success
+void collect_garbage(void);                   // finish a GC cycle and report
+void mark_staged_blobs(unsigned epoch);       // GC: staged blobs are live
+void set_compression(const char *level);      // NULL: show the setting
+void train_compression_dict(void);
 
 #endif /* MINIGIT_H */
@@ -0,0 +1,1074 @@
+#ifdef __linux__
+#define _GNU_SOURCE     // copy_file_range
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "object_store.h"
+#include "pack.h"
+#include "codec.h"
+#include "bytebuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <time.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close, unlink, write
+#include <dirent.h>     // opendir, readdir, closedir
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // mkdir, stat
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>   // FICLONE
+#endif
+
+#define INITIAL_BUCKETS 256
+
+/* Globals */
+static char    objects_dir[512] = "";     // empty: in-memory only
+static Blob  **buckets      = NULL;
+static size_t  bucket_count = 0;
+static size_t  blob_count   = 0;
+static size_t  blob_bytes   = 0;
+static unsigned gc_epoch    = 0;        // running GC cycle, see object_store_set_epoch
+
+/* Compression of new loose objects; dictionaries are loaded at init */
+#define ZOBJ_MAGIC    "MGZ"
+#define ZOBJ_VERSION  1
+#define ZOBJ_HEADER   9               // magic(3) version(1) level(1) dict_id(4)
+#define ZBLOCK_HEADER 8               // raw_len(4) stored_len(4); equal: stored as is
+
+static int        compress_level = 0;
+static CodecDict *dicts       = NULL;
+static int        dict_count  = 0;
+static const CodecDict *active_dict = NULL;
+
+/* =============== SHA-1 =================== */
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(uint32_t state[5], const unsigned char block[64]) {
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i*4] << 24) | ((uint32_t)block[i*4+1] << 16) |
+               ((uint32_t)block[i*4+2] << 8) | (uint32_t)block[i*4+3];
+    }
+    for (int i = 16; i < 80; i++)
+        w[i] = ROL32(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+        else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+
+        uint32_t t = ROL32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL32(b, 30);
+        b = a;
+        a = t;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void hash_init(HashContext *ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xEFCDAB89;
+    ctx->state[2] = 0x98BADCFE;
+    ctx->state[3] = 0x10325476;
+    ctx->state[4] = 0xC3D2E1F0;
+    ctx->length = 0;
+    ctx->buf_len = 0;
+}
+
+void hash_update(HashContext *ctx, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    ctx->length += len;
+
+    if (ctx->buf_len > 0) {
+        size_t take = 64 - ctx->buf_len;
+        if (take > len) take = len;
+        memcpy(ctx->buf + ctx->buf_len, p, take);
+        ctx->buf_len += take;
+        p += take;
+        len -= take;
+        if (ctx->buf_len < 64) return;
+        sha1_block(ctx->state, ctx->buf);
+        ctx->buf_len = 0;
+    }
+
+    while (len >= 64) {
+        sha1_block(ctx->state, p);
+        p += 64;
+        len -= 64;
+    }
+
+    memcpy(ctx->buf, p, len);
+    ctx->buf_len = len;
+}
+
+void hash_final(HashContext *ctx, ObjectId *out) {
+    uint64_t bits = ctx->length * 8;
+    unsigned char pad = 0x80;
+    unsigned char zero = 0;
+    unsigned char lenbuf[8];
+
+    hash_update(ctx, &pad, 1);
+    while (ctx->buf_len != 56)
+        hash_update(ctx, &zero, 1);
+
+    for (int i = 0; i < 8; i++)
+        lenbuf[i] = (unsigned char)(bits >> (56 - 8 * i));
+    hash_update(ctx, lenbuf, 8);
+
+    for (int i = 0; i < 5; i++) {
+        out->hash[i*4]   = (unsigned char)(ctx->state[i] >> 24);
+        out->hash[i*4+1] = (unsigned char)(ctx->state[i] >> 16);
+        out->hash[i*4+2] = (unsigned char)(ctx->state[i] >> 8);
+        out->hash[i*4+3] = (unsigned char)(ctx->state[i]);
+    }
+}
+
+void hash_buffer(const void *data, size_t len, ObjectId *out) {
+    HashContext ctx;
+    hash_init(&ctx);
+    hash_update(&ctx, data, len);
+    hash_final(&ctx, out);
+}
+
+/* Digest of a file's content without storing it */
+int hash_file(const char *path, ObjectId *out, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+
+    HashContext ctx;
+    unsigned char chunk[OBJECT_CHUNK_SIZE];
+    size_t n, total = 0;
+
+    hash_init(&ctx);
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        hash_update(&ctx, chunk, n);
+        total += n;
+    }
+    int failed = ferror(fp);
+    fclose(fp);
+    if (failed) return -1;
+
+    hash_final(&ctx, out);
+    if (size) *size = total;
+    return 0;
+}
+
+void object_id_to_hex(const ObjectId *id, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < OBJECT_ID_RAWSZ; i++) {
+        out[i*2]   = digits[id->hash[i] >> 4];
+        out[i*2+1] = digits[id->hash[i] & 0xf];
+    }
+    out[OBJECT_ID_HEXSZ] = '\0';
+}
+
+int object_id_equal(const ObjectId *a, const ObjectId *b) {
+    return memcmp(a->hash, b->hash, OBJECT_ID_RAWSZ) == 0;
+}
+
+/* =============== HASH TABLE =================== */
+
+/* The digest is already uniformly distributed: use its first bytes */
+static size_t bucket_of(const ObjectId *id, size_t nbuckets) {
+    size_t h = 0;
+    for (size_t i = 0; i < sizeof(size_t); i++)
+        h = (h << 8) | id->hash[i];
+    return h & (nbuckets - 1);
+}
+
+static void grow_buckets(void) {
+    size_t new_count = bucket_count ? bucket_count * 2 : INITIAL_BUCKETS;
+    Blob **new_buckets = calloc(new_count, sizeof(Blob *));
+    if (!new_buckets) return;        // keep the old table, chains just get longer
+
+    for (size_t i = 0; i < bucket_count; i++) {
+        Blob *b = buckets[i];
+        while (b) {
+            Blob *next = b->next;
+            size_t slot = bucket_of(&b->id, new_count);
+            b->next = new_buckets[slot];
+            new_buckets[slot] = b;
+            b = next;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+}
+
+/* =============== LOOSE OBJECTS =================== */
+
+static void object_path(const ObjectId *id, int compressed, char *out, size_t out_size) {
+    char hex[OBJECT_ID_HEXSZ + 1];
+    object_id_to_hex(id, hex);
+    snprintf(out, out_size, "%s/%.2s/%s%s", objects_dir, hex, hex + 2, compressed ? ".z" : "");
+}
+
+static int loose_exists(const ObjectId *id) {
+    char path[600];
+    struct stat st;
+    object_path(id, 0, path, sizeof(path));
+    if (stat(path, &st) == 0) return 1;
+    object_path(id, 1, path, sizeof(path));
+    return stat(path, &st) == 0;
+}
+
+static FILE *open_temp_object(char *tmp, size_t tmp_size) {
+    snprintf(tmp, tmp_size, "%s/tmp_obj_XXXXXX", objects_dir);
+    int fd = mkstemp(tmp);
+    if (fd < 0) return NULL;
+
+    FILE *fp = fdopen(fd, "wb");
+    if (!fp) {
+        close(fd);
+        unlink(tmp);
+    }
+    return fp;
+}
+
+/* Move a finished temp file to <objects>/xx/yyyy[.z] (or drop it if
+   the object is already stored, loose or packed) */
+static int install_object(const char *tmp, const ObjectId *id, int compressed) {
+    char path[600], dir[600];
+    struct stat st;
+
+    if (loose_exists(id) || pack_contains(id)) {
+        unlink(tmp);
+        return 0;
+    }
+
+    object_path(id, compressed, path, sizeof(path));
+    snprintf(dir, sizeof(dir), "%.*s", (int)(strrchr(path, '/') - path), path);
+    if (stat(dir, &st) == -1) mkdir(dir, 0700);
+
+    if (rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t get_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_le32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static const CodecDict *find_dict(uint32_t id) {
+    for (int i = 0; i < dict_count; i++)
+        if (dicts[i].id == id) return &dicts[i];
+    return NULL;
+}
+
+/* Map <objects>/xx/yyyy.z; NULL if the object is not stored that way */
+static unsigned char *map_compressed(const ObjectId *id, size_t *len) {
+    char path[600];
+    object_path(id, 1, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    void *map = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) map = NULL;
+        else *len = (size_t)st.st_size;
+    }
+    close(fd);
+    return map;
+}
+
+/* Decode a mapped .z object that must expand to size bytes: straight
+   into dst if given, else one block at a time into sink. Touches only
+   the (read-only) dictionaries, so any thread may call it. */
+static int decode_compressed(const unsigned char *p, size_t len, size_t size,
+                             unsigned char *dst, BlobSink sink, void *ctx) {
+    if (len < ZOBJ_HEADER || memcmp(p, ZOBJ_MAGIC, 3) != 0 || p[3] != ZOBJ_VERSION)
+        return -1;
+
+    uint32_t dict_id = get_le32(p + 5);
+    const CodecDict *dict = dict_id ? find_dict(dict_id) : NULL;
+    if (dict_id && !dict) return -1;
+
+    unsigned char *buf = dst ? NULL : malloc(OBJECT_CHUNK_SIZE);
+    if (!dst && !buf) return -1;
+
+    size_t pos = ZOBJ_HEADER, done = 0;
+    int rc = 0;
+    while (rc == 0 && pos < len) {
+        if (len - pos < ZBLOCK_HEADER) {
+            rc = -1;
+            break;
+        }
+        size_t raw = get_le32(p + pos), stored = get_le32(p + pos + 4);
+        pos += ZBLOCK_HEADER;
+        if (stored > len - pos || raw > OBJECT_CHUNK_SIZE || raw > size - done) {
+            rc = -1;
+            break;
+        }
+
+        unsigned char *out = dst ? dst + done : buf;
+        if (stored == raw) memcpy(out, p + pos, raw);
+        else if (codec_decompress(p + pos, stored, out, raw, dict) != 0) rc = -1;
+        if (rc == 0 && sink) rc = sink(out, raw, ctx);
+
+        pos += stored;
+        done += raw;
+    }
+
+    free(buf);
+    if (rc == 0 && done != size) rc = -1;
+    return rc;
+}
+
+static unsigned char *read_loose_object(const ObjectId *id, size_t size) {
+    char path[600];
+    object_path(id, 0, path, sizeof(path));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        size_t len = 0;
+        unsigned char *map = map_compressed(id, &len);
+        if (!map) return NULL;
+
+        unsigned char *data = malloc(size + 1);
+        if (data && decode_compressed(map, len, size, data, NULL, NULL) != 0) {
+            free(data);
+            data = NULL;
+        }
+        munmap(map, len);
+        if (data) data[size] = '\0';
+        return data;
+    }
+
+    unsigned char *data = malloc(size + 1);
+    if (!data) {
+        fclose(fp);
+        return NULL;
+    }
+
+    size_t n = fread(data, 1, size, fp);
+    fclose(fp);
+    if (n != size) {
+        free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+    return data;
+}
+
+/* =============== COMPRESSION SETTINGS =================== */
+
+static void dict_dir_path(char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/dict", objects_dir);
+}
+
+/* The id is the first four bytes of the dictionary's digest (never 0) */
+static uint32_t dict_id_of(const unsigned char *data, size_t len) {
+    ObjectId digest;
+    hash_buffer(data, len, &digest);
+    uint32_t id = (uint32_t)digest.hash[0] << 24 | (uint32_t)digest.hash[1] << 16 |
+                  (uint32_t)digest.hash[2] << 8 | digest.hash[3];
+    return id ? id : 1;
+}
+
+static int register_dict(unsigned char *data, size_t len, uint32_t id) {
+    if (find_dict(id)) {
+        free(data);
+        return 0;
+    }
+    CodecDict *p = realloc(dicts, (size_t)(dict_count + 1) * sizeof(CodecDict));
+    if (!p) {
+        free(data);
+        return -1;
+    }
+    dicts = p;
+    dicts[dict_count++] = (CodecDict){ id, data, len };
+    return 0;
+}
+
+static void load_dicts(void) {
+    char dir[600];
+    dict_dir_path(dir, sizeof(dir));
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    struct dirent *dp;
+    while ((dp = readdir(d))) {
+        char *end;
+        unsigned long id = strtoul(dp->d_name, &end, 16);
+        if (strlen(dp->d_name) != 8 || *end != '\0') continue;
+
+        char path[900];
+        snprintf(path, sizeof(path), "%s/%s", dir, dp->d_name);
+        FILE *fp = fopen(path, "rb");
+        if (!fp) continue;
+
+        unsigned char *data = malloc(CODEC_DICT_MAX);
+        size_t len = data ? fread(data, 1, CODEC_DICT_MAX, fp) : 0;
+        fclose(fp);
+        if (len == 0 || dict_id_of(data, len) != (uint32_t)id) {
+            printf("Warning: ignoring damaged dictionary %s\n", path);
+            free(data);
+            continue;
+        }
+        register_dict(data, len, (uint32_t)id);
+    }
+    closedir(d);
+}
+
+int object_store_set_compression(int level, uint32_t dict_id) {
+    if (level < 0) level = 0;
+    if (level > CODEC_MAX_LEVEL) level = CODEC_MAX_LEVEL;
+    compress_level = objects_dir[0] ? level : 0;
+
+    active_dict = dict_id ? find_dict(dict_id) : NULL;
+    return dict_id && !active_dict ? -1 : 0;
+}
+
+int object_store_compression(uint32_t *dict_id) {
+    if (dict_id) *dict_id = active_dict ? active_dict->id : 0;
+    return compress_level;
+}
+
+/* Save a dictionary under <objects>/dict/ and make it usable for reads;
+   object_store_set_compression() decides whether new objects use it */
+int object_store_add_dict(const unsigned char *data, size_t len, uint32_t *id) {
+    if (!objects_dir[0] || len == 0 || len > CODEC_DICT_MAX) return -1;
+
+    char dir[600], path[700];
+    struct stat st;
+    *id = dict_id_of(data, len);
+    dict_dir_path(dir, sizeof(dir));
+    if (stat(dir, &st) == -1 && mkdir(dir, 0700) != 0) return -1;
+    snprintf(path, sizeof(path), "%s/%08x", dir, (unsigned)*id);
+    if (write_file_atomic(path, data, len) != 0) return -1;
+
+    unsigned char *copy = malloc(len);
+    if (!copy) return -1;
+    memcpy(copy, data, len);
+    return register_dict(copy, len, *id);
+}
+
+/* =============== OBJECT STORE =================== */
+
+static void pack_dir_path(char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/pack", objects_dir);
+}
+
+void object_store_init(const char *dir) {
+    object_store_clear();
+    snprintf(objects_dir, sizeof(objects_dir), "%s", dir ? dir : "");
+    grow_buckets();
+
+    if (objects_dir[0]) {
+        char pack_dir[600];
+        pack_dir_path(pack_dir, sizeof(pack_dir));
+        pack_open(pack_dir);
+        load_dicts();
+    }
+}
+
+void object_store_clear(void) {
+    for (size_t i = 0; i < bucket_count; i++) {
+        Blob *b = buckets[i];
+        while (b) {
+            Blob *next = b->next;
+            free(b->data);
+            if (b->map) munmap(b->map, b->size);
+            free(b);
+            b = next;
+        }
+    }
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+    blob_count = 0;
+    blob_bytes = 0;
+    pack_close();
+
+    for (int i = 0; i < dict_count; i++)
+        free((void *)dicts[i].data);
+    free(dicts);
+    dicts = NULL;
+    dict_count = 0;
+    active_dict = NULL;
+    compress_level = 0;
+}
+
+Blob *object_store_get(const ObjectId *id) {
+    if (!buckets) return NULL;
+
+    Blob *b = buckets[bucket_of(id, bucket_count)];
+    while (b) {
+        if (object_id_equal(&b->id, id)) return b;
+        b = b->next;
+    }
+    return NULL;
+}
+
+int object_store_exists(const ObjectId *id) {
+    Blob *b = object_store_get(id);
+    if (b && b->data) return 1;
+    if (!objects_dir[0]) return 0;
+
+    return loose_exists(id) || pack_contains(id);
+}
+
+static Blob *insert_blob(const ObjectId *id, size_t size, unsigned char *data) {
+    if (!buckets || blob_count + 1 > bucket_count * 3 / 4)
+        grow_buckets();
+    if (!buckets) return NULL;
+
+    Blob *b = malloc(sizeof(Blob));
+    if (!b) return NULL;
+
+    b->id = *id;
+    b->size = size;
+    b->data = data;
+    b->map = NULL;
+    b->refcount = 1;
+    b->mark = 0;
+    b->reached = gc_epoch;
+
+    size_t slot = bucket_of(id, bucket_count);
+    b->next = buckets[slot];
+    buckets[slot] = b;
+
+    blob_count++;
+    blob_bytes += size;
+    return b;
+}
+
+/* =============== STREAMING WRITES =================== */
+
+int object_writer_open(ObjectWriter *w) {
+    memset(w, 0, sizeof(*w));
+    hash_init(&w->ctx);
+
+    if (!objects_dir[0]) return 0;                // accumulate in memory
+    w->fp = open_temp_object(w->tmp_path, sizeof(w->tmp_path));
+    if (!w->fp) return -1;
+
+    w->level = compress_level;
+    w->dict = active_dict;
+    if (w->level == 0) return 0;
+
+    unsigned char header[ZOBJ_HEADER];
+    memcpy(header, ZOBJ_MAGIC, 3);
+    header[3] = ZOBJ_VERSION;
+    header[4] = (unsigned char)w->level;
+    put_le32(header + 5, w->dict ? w->dict->id : 0);
+    if (fwrite(header, 1, sizeof(header), w->fp) != sizeof(header)) {
+        object_writer_abort(w);
+        return -1;
+    }
+    return 0;
+}
+
+/* block holds the input in its first OBJECT_CHUNK_SIZE bytes and the
+   compressed output after it */
+static int write_block(ObjectWriter *w) {
+    if (!w->scratch && !(w->scratch = codec_scratch_new())) return -1;
+
+    unsigned char *out = w->block + OBJECT_CHUNK_SIZE;
+    size_t n = codec_compress(w->scratch, w->block, w->block_len, out, w->level, w->dict);
+    if (n >= w->block_len) {                      // incompressible: store it
+        n = w->block_len;
+        out = w->block;
+    }
+
+    unsigned char header[ZBLOCK_HEADER];
+    put_le32(header, (uint32_t)w->block_len);
+    put_le32(header + 4, (uint32_t)n);
+    w->block_len = 0;
+    if (fwrite(header, 1, sizeof(header), w->fp) != sizeof(header) ||
+        fwrite(out, 1, n, w->fp) != n)
+        return -1;
+    return 0;
+}
+
+static int write_compressed(ObjectWriter *w, const unsigned char *p, size_t len) {
+    if (!w->block && !(w->block = malloc(OBJECT_CHUNK_SIZE + codec_bound(OBJECT_CHUNK_SIZE))))
+        return -1;
+
+    while (len > 0) {
+        size_t n = OBJECT_CHUNK_SIZE - w->block_len;
+        if (n > len) n = len;
+        memcpy(w->block + w->block_len, p, n);
+        w->block_len += n;
+        p += n;
+        len -= n;
+        if (w->block_len == OBJECT_CHUNK_SIZE && write_block(w) != 0) return -1;
+    }
+    return 0;
+}
+
+int object_writer_write(ObjectWriter *w, const void *data, size_t len) {
+    hash_update(&w->ctx, data, len);
+    w->size += len;
+
+    if (w->fp && w->level > 0)
+        return write_compressed(w, data, len);
+    if (w->fp)
+        return fwrite(data, 1, len, w->fp) == len ? 0 : -1;
+
+    if (w->size + 1 > w->mem_cap) {
+        size_t cap = w->mem_cap ? w->mem_cap : OBJECT_CHUNK_SIZE;
+        while (cap < w->size + 1) cap *= 2;
+        unsigned char *p = realloc(w->mem, cap);
+        if (!p) return -1;
+        w->mem = p;
+        w->mem_cap = cap;
+    }
+    memcpy(w->mem + w->size - len, data, len);
+    return 0;
+}
+
+int object_writer_flush(ObjectWriter *w) {
+    int rc = 0;
+    if (w->fp && w->block_len > 0) rc = write_block(w);
+
+    codec_scratch_free(w->scratch);
+    free(w->block);
+    w->scratch = NULL;
+    w->block = NULL;
+    return rc;
+}
+
+void object_writer_abort(ObjectWriter *w) {
+    if (w->fp) {
+        fclose(w->fp);
+        unlink(w->tmp_path);
+    }
+    codec_scratch_free(w->scratch);
+    free(w->block);
+    free(w->mem);
+    memset(w, 0, sizeof(*w));
+}
+
+Blob *object_writer_finish(ObjectWriter *w, int *is_new) {
+    ObjectId id;
+    hash_final(&w->ctx, &id);
+
+    if (w->fp) {
+        int failed = object_writer_flush(w) != 0;
+        failed |= fclose(w->fp) != 0;
+        w->fp = NULL;
+        if (failed) {
+            unlink(w->tmp_path);
+            return NULL;
+        }
+    }
+
+    Blob *existing = object_store_get(&id);
+    if (existing) {
+        if (objects_dir[0]) unlink(w->tmp_path);
+        free(w->mem);
+        if (is_new) *is_new = 0;
+        return blob_retain(existing);
+    }
+
+    if (objects_dir[0] && install_object(w->tmp_path, &id, w->level > 0) != 0) {
+        printf("Error: cannot write object to %s/\n", objects_dir);
+        return NULL;
+    }
+
+    unsigned char *data = NULL;
+    if (!objects_dir[0]) {
+        data = w->mem ? w->mem : malloc(1);
+        if (!data) return NULL;
+        data[w->size] = '\0';
+    }
+
+    Blob *b = insert_blob(&id, w->size, data);
+    if (!b) {
+        free(data);
+        return NULL;
+    }
+
+    if (is_new) *is_new = 1;
+    return b;
+}
+
+Blob *object_store_put(const void *data, size_t size, int *is_new) {
+    ObjectWriter w;
+    if (object_writer_open(&w) != 0) return NULL;
+    if (object_writer_write(&w, data, size) != 0) {
+        object_writer_abort(&w);
+        return NULL;
+    }
+    return object_writer_finish(&w, is_new);
+}
+
+/* Hash and store a file chunk by chunk: memory use is one chunk */
+Blob *object_store_put_file(const char *path, int *is_new) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    ObjectWriter w;
+    if (object_writer_open(&w) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    unsigned char chunk[OBJECT_CHUNK_SIZE];
+    size_t n;
+    int failed = 0;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        if (object_writer_write(&w, chunk, n) != 0) {
+            failed = 1;
+            break;
+        }
+    }
+    if (ferror(fp)) failed = 1;
+    fclose(fp);
+
+    if (failed) {
+        object_writer_abort(&w);
+        return NULL;
+    }
+    return object_writer_finish(&w, is_new);
+}
+
+Blob *object_store_ref(const ObjectId *id, size_t size) {
+    Blob *existing = object_store_get(id);
+    if (existing) return blob_retain(existing);
+    return insert_blob(id, size, NULL);
+}
+
+const unsigned char *blob_data(Blob *blob) {
+    if (!blob) return NULL;
+    if (!blob->data && objects_dir[0]) {
+        blob->data = read_loose_object(&blob->id, blob->size);
+        if (!blob->data) {
+            size_t size = 0;
+            blob->data = pack_read_object(&blob->id, &size);
+            if (blob->data && size != blob->size) {
+                free(blob->data);
+                blob->data = NULL;
+            }
+        }
+    }
+    return blob->data;
+}
+
+const unsigned char *blob_view(Blob *blob) {
+    if (!blob) return NULL;
+    if (blob->data) return blob->data;
+    if (blob->map) return blob->map;
+
+    if (objects_dir[0] && blob->size > 0) {
+        char path[600];
+        object_path(&blob->id, 0, path, sizeof(path));
+
+        int fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            struct stat st;
+            void *map = MAP_FAILED;
+            if (fstat(fd, &st) == 0 && (size_t)st.st_size == blob->size)
+                map = mmap(NULL, blob->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (map != MAP_FAILED) {
+                blob->map = map;
+                return blob->map;
+            }
+        }
+    }
+    return blob_data(blob);
+}
+
+/* Feed the content to sink chunk by chunk. Loose objects are streamed
+   from disk (compressed ones a block at a time); cached or packed
+   content is handed over in one piece. */
+int blob_stream(Blob *blob, BlobSink sink, void *ctx) {
+    if (!blob) return -1;
+
+    if (!blob->data && objects_dir[0]) {
+        char path[600];
+        object_path(&blob->id, 0, path, sizeof(path));
+
+        FILE *fp = fopen(path, "rb");
+        if (fp) {
+            unsigned char chunk[OBJECT_CHUNK_SIZE];
+            size_t n, total = 0;
+            int rc = 0;
+            while (rc == 0 && (n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+                total += n;
+                rc = sink(chunk, n, ctx);
+            }
+            fclose(fp);
+            if (rc != 0) return rc;
+            return total == blob->size ? 0 : -1;
+        }
+
+        size_t len = 0;
+        unsigned char *map = map_compressed(&blob->id, &len);
+        if (map) {
+            int rc = decode_compressed(map, len, blob->size, NULL, sink, ctx);
+            munmap(map, len);
+            return rc;
+        }
+    }
+
+    const unsigned char *data = blob_data(blob);
+    if (!data) return -1;
+    return blob->size ? sink(data, blob->size, ctx) : 0;
+}
+
+/* =============== MATERIALIZE =================== */
+
+static int write_all(int fd, const unsigned char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Copy size bytes of in to out, letting the kernel do it when it can */
+static int copy_object_fd(int in, int out, size_t size) {
+    size_t done = 0;
+
+#ifdef __linux__
+    /* Reflink: shares the extents, no data is copied (btrfs, xfs, ...) */
+    if (ioctl(out, FICLONE, in) == 0) return 0;
+
+    /* In-kernel copy (server-side on NFS/CIFS, no user-space buffers) */
+    while (done < size) {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, size - done, 0);
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    if (done == size) return 0;
+#endif
+
+    /* Write the rest straight out of a mapping of the object */
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, in, 0);
+    if (map == MAP_FAILED) return -1;
+    int rc = write_all(out, (const unsigned char *)map + done, size - done);
+    munmap(map, size);
+    return rc;
+}
+
+static int write_sink(const unsigned char *chunk, size_t len, void *ctx) {
+    return write_all(*(int *)ctx, chunk, len);
+}
+
+int blob_materialize(const Blob *blob, const char *dest_path) {
+    int out = open(dest_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) return -1;
+
+    int rc = -1;
+    if (blob->data || blob->size == 0) {
+        rc = write_all(out, blob->data, blob->size);
+    } else if (objects_dir[0]) {
+        char path[600];
+        object_path(&blob->id, 0, path, sizeof(path));
+
+        int in = open(path, O_RDONLY);
+        size_t len = 0;
+        unsigned char *map = NULL;
+        if (in >= 0) {
+            rc = copy_object_fd(in, out, blob->size);
+            close(in);
+        } else if ((map = map_compressed(&blob->id, &len)) != NULL) {
+            rc = decode_compressed(map, len, blob->size, NULL, write_sink, &out);
+            munmap(map, len);
+        } else {
+            size_t size = 0;
+            unsigned char *data = pack_read_object(&blob->id, &size);
+            if (data && size == blob->size)
+                rc = write_all(out, data, size);
+            free(data);
+        }
+    }
+
+    if (close(out) != 0) rc = -1;
+    return rc;
+}
+
+void blob_evict(Blob *blob) {
+    if (!blob || !objects_dir[0]) return;         // memory is the only copy
+    free(blob->data);
+    blob->data = NULL;
+    if (blob->map) munmap(blob->map, blob->size);
+    blob->map = NULL;
+}
+
+int object_store_repack(Blob **blobs, const int *chain_id, int count, PackStats *stats) {
+    if (!objects_dir[0]) return -1;
+
+    char pack_dir[600];
+    pack_dir_path(pack_dir, sizeof(pack_dir));
+    if (pack_write(pack_dir, blobs, chain_id, count, stats) != 0)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        char path[600];
+        object_path(&blobs[i]->id, 0, path, sizeof(path));
+        int removed = unlink(path) == 0;
+        object_path(&blobs[i]->id, 1, path, sizeof(path));
+        removed |= unlink(path) == 0;
+        if (removed) {
+            *strrchr(path, '/') = '\0';
+            rmdir(path);                          // only succeeds once empty
+        }
+    }
+    return 0;
+}
+
+Blob *blob_retain(Blob *blob) {
+    blob->refcount++;
+    if (gc_epoch) blob->reached = gc_epoch;
+    return blob;
+}
+
+/* Drop one reference; the content is freed once no commit uses it */
+void blob_release(Blob *blob) {
+    if (!blob || --blob->refcount > 0) return;
+
+    size_t slot = bucket_of(&blob->id, bucket_count);
+    Blob **pp = &buckets[slot];
+    while (*pp && *pp != blob)
+        pp = &(*pp)->next;
+    if (*pp) *pp = blob->next;
+
+    blob_count--;
+    blob_bytes -= blob->size;
+
+    free(blob->data);
+    if (blob->map) munmap(blob->map, blob->size);
+    free(blob);
+}
+
+/* Make every object written so far durable with one call instead of
+   one fsync per file: syncfs() flushes the objects' filesystem */
+int object_store_sync(void) {
+    if (!objects_dir[0]) return 0;
+#ifdef __linux__
+    int fd = open(objects_dir, O_RDONLY);
+    if (fd < 0) return -1;
+    int rc = syncfs(fd);
+    close(fd);
+    return rc;
+#else
+    sync();
+    return 0;
+#endif
+}
+
+/* =============== SWEEP =================== */
+
+static int hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    return -1;
+}
+
+/* Loose object file name (38 hex digits, ".z" if compressed) under
+   fan-out directory xx */
+static int parse_loose_name(int fanout, const char *name, ObjectId *out) {
+    size_t len = strlen(name);
+    if (len != OBJECT_ID_HEXSZ - 2 &&
+        (len != OBJECT_ID_HEXSZ || strcmp(name + OBJECT_ID_HEXSZ - 2, ".z") != 0))
+        return -1;
+    out->hash[0] = (unsigned char)fanout;
+    for (int i = 1; i < OBJECT_ID_RAWSZ; i++) {
+        int hi = hex_digit(name[2 * i - 2]), lo = hex_digit(name[2 * i - 1]);
+        if (hi < 0 || lo < 0) return -1;
+        out->hash[i] = (unsigned char)(hi << 4 | lo);
+    }
+    return 0;
+}
+
+static void remove_counted(const char *path, SweepStats *st) {
+    struct stat sb;
+    if (stat(path, &sb) != 0 || unlink(path) != 0) return;
+    st->removed++;
+    st->bytes += (size_t)sb.st_size;
+}
+
+void object_store_set_epoch(unsigned epoch) {
+    gc_epoch = epoch;
+}
+
+int object_store_sweep_fanout(int fanout, ObjectLiveFn live, void *ctx, SweepStats *st) {
+    if (!objects_dir[0]) return 0;
+
+    char dir[600];
+    snprintf(dir, sizeof(dir), "%s/%02x", objects_dir, fanout & 0xff);
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+
+    int examined = 0, removed = st->removed;
+    struct dirent *dp;
+    while ((dp = readdir(d))) {
+        if (dp->d_name[0] == '.') continue;
+        examined++;
+
+        ObjectId id;
+        if (parse_loose_name(fanout, dp->d_name, &id) != 0 || live(&id, ctx))
+            continue;
+
+        char path[900];
+        snprintf(path, sizeof(path), "%s/%s", dir, dp->d_name);
+        remove_counted(path, st);
+    }
+    closedir(d);
+
+    if (st->removed != removed) rmdir(dir);       // only succeeds once empty
+    return examined;
+}
+
+void object_store_sweep_temp(SweepStats *st) {
+    if (!objects_dir[0]) return;
+
+    DIR *d = opendir(objects_dir);
+    if (!d) return;
+
+    time_t now = time(NULL);
+    struct dirent *dp;
+    while ((dp = readdir(d))) {
+        if (strncmp(dp->d_name, "tmp_obj_", 8) != 0) continue;
+
+        char path[900];
+        struct stat sb;
+        snprintf(path, sizeof(path), "%s/%s", objects_dir, dp->d_name);
+        if (stat(path, &sb) == 0 && now - sb.st_mtime > OBJECT_TEMP_MAX_AGE)
+            remove_counted(path, st);
+    }
+    closedir(d);
+}
+
+void object_store_stats(size_t *count, size_t *bytes) {
+    if (count) *count = blob_count;
+    if (bytes) *bytes = blob_bytes;
+}
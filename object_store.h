@@ -0,0 +1,155 @@
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OBJECT_ID_RAWSZ 20               // SHA-1 digest
+#define OBJECT_ID_HEXSZ 40
+#define OBJECT_CHUNK_SIZE (64 * 1024)    // streaming read/write unit
+
+/* -------- Object Id (content digest) -------- */
+typedef struct ObjectId {
+    unsigned char hash[OBJECT_ID_RAWSZ];
+} ObjectId;
+
+/* -------- Blob: one stored file content, shared by all commits -------- */
+typedef struct Blob {
+    ObjectId id;
+    size_t size;
+    unsigned char *data;          // size bytes + NUL, NULL until first use
+    unsigned char *map;           // read-only mapping of a raw loose object (blob_view)
+    int refcount;                 // number of CommitFiles referencing it
+    int mark;                     // scratch flag for whole-store walks
+    unsigned reached;             // GC cycle that last reached it (see gc.h)
+    struct Blob *next;            // hash bucket chain
+} Blob;
+
+/* -------- Streaming SHA-1 -------- */
+typedef struct HashContext {
+    uint32_t state[5];
+    uint64_t length;
+    unsigned char buf[64];
+    size_t buf_len;
+} HashContext;
+
+void hash_init(HashContext *ctx);
+void hash_update(HashContext *ctx, const void *data, size_t len);
+void hash_final(HashContext *ctx, ObjectId *out);
+void hash_buffer(const void *data, size_t len, ObjectId *out);
+int  hash_file(const char *path, ObjectId *out, size_t *size);   // 0 on success
+
+void object_id_to_hex(const ObjectId *id, char *out);   // out: OBJECT_ID_HEXSZ + 1
+int  object_id_equal(const ObjectId *a, const ObjectId *b);
+
+/* -------- Object Store API -------- */
+/* objects_dir holds loose objects as <dir>/xx/<38 hex> (raw) or
+   <dir>/xx/<38 hex>.z (compressed); NULL keeps everything in memory only. */
+void  object_store_init(const char *objects_dir);
+void  object_store_clear(void);
+
+/* Store content; returns the shared blob (refcount incremented).
+   *is_new is set to 1 if the content was not stored before. */
+Blob *object_store_put(const void *data, size_t size, int *is_new);
+Blob *object_store_put_file(const char *path, int *is_new);
+Blob *object_store_get(const ObjectId *id);
+int   object_store_exists(const ObjectId *id);    // loose or packed on disk
+
+/* Reference an object already on disk without reading it */
+Blob *object_store_ref(const ObjectId *id, size_t size);
+
+/* -------- Compressed loose objects (codec.h) -------- */
+/* At level > 0 new loose objects are written as a header and
+   independently compressed OBJECT_CHUNK_SIZE blocks, optionally
+   against a trained dictionary kept in <dir>/dict/<8 hex id>. Level 0
+   writes raw files, which checkout can reflink. Either kind of file
+   stays readable whatever the current setting; packs are unaffected.
+   The setting is read by writers on worker threads: change it only
+   while no snapshot is running. */
+int   object_store_set_compression(int level, uint32_t dict_id);   // -1 if dict_id is unknown
+int   object_store_compression(uint32_t *dict_id);
+int   object_store_add_dict(const unsigned char *data, size_t len, uint32_t *id);
+
+/* -------- Streaming writer: hash + store in OBJECT_CHUNK_SIZE pieces -------- */
+struct CodecScratch;
+struct CodecDict;
+
+typedef struct ObjectWriter {
+    HashContext ctx;
+    FILE *fp;                     // temp file inside the objects dir
+    unsigned char *mem;           // in-memory store: accumulated content
+    size_t size;
+    size_t mem_cap;
+    char tmp_path[640];
+    int level;                    // > 0: fp receives compressed blocks
+    const struct CodecDict *dict;
+    struct CodecScratch *scratch;
+    unsigned char *block;         // input of the next block, then its output
+    size_t block_len;
+} ObjectWriter;
+
+int   object_writer_open(ObjectWriter *w);
+int   object_writer_write(ObjectWriter *w, const void *data, size_t len);
+/* Compress and write any partial block and drop the compressor state,
+   so this work happens on the writing thread rather than in finish() */
+int   object_writer_flush(ObjectWriter *w);
+Blob *object_writer_finish(ObjectWriter *w, int *is_new);     // NULL on error
+void  object_writer_abort(ObjectWriter *w);
+
+/* Streaming read: sink returns 0 to continue, non-zero to stop */
+typedef int (*BlobSink)(const unsigned char *chunk, size_t len, void *ctx);
+int   blob_stream(Blob *blob, BlobSink sink, void *ctx);
+
+/* Write a blob to dest_path (created or truncated). Touches no shared
+   state, so checkout can run it on worker threads: raw loose objects
+   are reflinked or copy_file_range'd where the filesystem allows, else
+   written from a mapping; compressed and packed objects are decoded
+   and written. */
+int   blob_materialize(const Blob *blob, const char *dest_path);
+
+/* Content of a blob, read from disk on first use. NULL on error. */
+const unsigned char *blob_data(Blob *blob);
+
+/* The same bytes without a copy where possible: a raw loose object is
+   mapped once and the mapping kept with the blob; other objects fall
+   back to blob_data(). Not NUL-terminated. Valid until blob_evict() or
+   blob_release(); main thread only, like blob_data(). */
+const unsigned char *blob_view(Blob *blob);
+void  blob_evict(Blob *blob);             // drop cached content and mapping (reloadable)
+Blob *blob_retain(Blob *blob);            // take another reference; returns blob
+void  blob_release(Blob *blob);
+
+/* Rewrite the pack with these blobs (see pack.h for chain_id) and
+   remove the loose copies. Returns 0 on success. */
+struct PackStats;
+int   object_store_repack(Blob **blobs, const int *chain_id, int count,
+                          struct PackStats *stats);
+
+int   object_store_sync(void);           // flush all written objects to disk
+
+/* -------- Sweeping unreachable objects (driven by gc.c) -------- */
+#define OBJECT_FANOUT        256         // <objects>/00 .. <objects>/ff
+#define OBJECT_TEMP_MAX_AGE  (60 * 60)   // seconds before a temp file counts as abandoned
+
+typedef int (*ObjectLiveFn)(const ObjectId *id, void *ctx);
+
+/* While a cycle runs (epoch != 0), blobs stored, referenced or retained
+   are stamped reached with its epoch, as the mark may have passed the
+   commits that will hold them. 0 when no cycle runs. */
+void  object_store_set_epoch(unsigned epoch);
+
+typedef struct SweepStats {
+    int removed;
+    size_t bytes;
+} SweepStats;
+
+/* Remove the loose objects of one fan-out directory for which live()
+   returns 0. Returns the number of entries examined. */
+int   object_store_sweep_fanout(int fanout, ObjectLiveFn live, void *ctx, SweepStats *st);
+
+/* Remove temp files left behind by writers that never finished */
+void  object_store_sweep_temp(SweepStats *st);
+void  object_store_stats(size_t *blob_count, size_t *total_bytes);
+
+#endif /* OBJECT_STORE_H */
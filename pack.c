@@ -0,0 +1,390 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pack.h"
+#include "bytebuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat, mkdir
+
+#define PACK_MAGIC     "MGITPACK"
+#define PACK_VERSION   1
+#define TRAILER_MAGIC  "MGPK"
+#define TRAILER_SIZE   16         // index offset(8) + count(4) + magic(4)
+#define INDEX_ENTRY    (OBJECT_ID_RAWSZ + 8)
+
+#define ENTRY_FULL     1
+#define ENTRY_DELTA    2
+
+#define DELTA_OP_COPY   0
+#define DELTA_OP_INSERT 1
+#define DELTA_BLOCK     16        // bytes per fingerprinted base block
+
+/* Mapped pack (at most one is open) */
+static unsigned char *pack_map   = NULL;
+static size_t         pack_len   = 0;
+static const unsigned char *pack_index = NULL;    // sorted (hash, offset)
+static uint32_t       pack_count = 0;
+
+/* =============== DELTA ENCODING =================== */
+
+static uint32_t block_hash(const unsigned char *p) {
+    uint32_t h = 2166136261u;                       // FNV-1a
+    for (int i = 0; i < DELTA_BLOCK; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void emit_insert(ByteBuf *out, const unsigned char *p, size_t len) {
+    if (len == 0) return;
+    buf_put_uint(out, DELTA_OP_INSERT, 1);
+    buf_put_varint(out, len);
+    buf_put(out, p, len);
+}
+
+/* Greedy block matcher: fingerprint every DELTA_BLOCK-aligned block of
+   the base, slide over the target, and extend each hit in both
+   directions. Returns NULL if the delta would exceed max_delta bytes. */
+unsigned char *delta_create(const unsigned char *base, size_t base_len,
+                            const unsigned char *target, size_t target_len,
+                            size_t max_delta, size_t *delta_len) {
+    size_t blocks = base_len / DELTA_BLOCK;
+    size_t table_size = 1;
+    while (table_size < blocks * 2) table_size <<= 1;
+
+    size_t *table = calloc(table_size, sizeof(size_t));     // offset + 1, 0 = empty
+    if (!table) return NULL;
+
+    for (size_t k = blocks; k-- > 0;) {
+        size_t off = k * DELTA_BLOCK;
+        table[block_hash(base + off) & (table_size - 1)] = off + 1;
+    }
+
+    ByteBuf out = {0};
+    buf_put_varint(&out, base_len);
+    buf_put_varint(&out, target_len);
+
+    size_t i = 0, pending = 0;
+    while (blocks && i + DELTA_BLOCK <= target_len) {
+        size_t cand = table[block_hash(target + i) & (table_size - 1)];
+        if (!cand || memcmp(base + cand - 1, target + i, DELTA_BLOCK) != 0) {
+            i++;
+            continue;
+        }
+
+        size_t src = cand - 1, len = DELTA_BLOCK;
+        while (src + len < base_len && i + len < target_len &&
+               base[src + len] == target[i + len])
+            len++;
+        while (i > pending && src > 0 && base[src - 1] == target[i - 1]) {
+            i--;
+            src--;
+            len++;
+        }
+
+        emit_insert(&out, target + pending, i - pending);
+        buf_put_uint(&out, DELTA_OP_COPY, 1);
+        buf_put_varint(&out, src);
+        buf_put_varint(&out, len);
+
+        i += len;
+        pending = i;
+        if (out.len > max_delta) break;
+    }
+    emit_insert(&out, target + pending, target_len - pending);
+    free(table);
+
+    if (out.failed || out.len > max_delta) {
+        buf_free(&out);
+        return NULL;
+    }
+    *delta_len = out.len;
+    return out.data;
+}
+
+unsigned char *delta_apply(const unsigned char *base, size_t base_len,
+                           const unsigned char *delta, size_t delta_len,
+                           size_t *out_len) {
+    Reader rd = { delta, delta + delta_len, 1 };
+    size_t want_base = (size_t)rd_varint(&rd);
+    size_t size = (size_t)rd_varint(&rd);
+    if (!rd.ok || want_base != base_len) return NULL;
+
+    unsigned char *out = malloc(size + 1);
+    if (!out) return NULL;
+
+    size_t pos = 0;
+    while (rd.ok && rd.p < rd.end) {
+        int op = (int)rd_uint(&rd, 1);
+        if (op == DELTA_OP_COPY) {
+            size_t src = (size_t)rd_varint(&rd);
+            size_t len = (size_t)rd_varint(&rd);
+            if (!rd.ok || src > base_len || len > base_len - src || len > size - pos) break;
+            memcpy(out + pos, base + src, len);
+            pos += len;
+        } else if (op == DELTA_OP_INSERT) {
+            size_t len = (size_t)rd_varint(&rd);
+            const unsigned char *p = rd_bytes(&rd, len);
+            if (!p || len > size - pos) break;
+            memcpy(out + pos, p, len);
+            pos += len;
+        } else {
+            break;
+        }
+    }
+
+    if (!rd.ok || rd.p != rd.end || pos != size) {
+        free(out);
+        return NULL;
+    }
+    out[size] = '\0';
+    *out_len = size;
+    return out;
+}
+
+/* =============== READING =================== */
+
+int pack_open(const char *pack_dir) {
+    pack_close();
+
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", pack_dir, PACK_FILE_NAME);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;                          // no pack yet
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < 9 + TRAILER_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const unsigned char *m = map;
+    Reader tr = { m + len - TRAILER_SIZE, m + len, 1 };
+    uint64_t index_off = rd_uint(&tr, 8);
+    uint32_t count = (uint32_t)rd_uint(&tr, 4);
+    const unsigned char *magic = rd_bytes(&tr, 4);
+
+    if (memcmp(m, PACK_MAGIC, 8) != 0 || m[8] != PACK_VERSION ||
+        !tr.ok || memcmp(magic, TRAILER_MAGIC, 4) != 0 ||
+        index_off > len - TRAILER_SIZE ||
+        (len - TRAILER_SIZE - index_off) / INDEX_ENTRY < count) {
+        munmap(map, len);
+        printf("Warning: %s is not a valid pack, ignored.\n", path);
+        return -1;
+    }
+
+    pack_map = map;
+    pack_len = len;
+    pack_index = m + index_off;
+    pack_count = count;
+    return 0;
+}
+
+void pack_close(void) {
+    if (pack_map) munmap(pack_map, pack_len);
+    pack_map = NULL;
+    pack_len = 0;
+    pack_index = NULL;
+    pack_count = 0;
+}
+
+/* Binary search in the sorted index; returns the entry offset or 0 */
+static uint64_t find_offset(const ObjectId *id) {
+    uint32_t lo = 0, hi = pack_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const unsigned char *e = pack_index + (size_t)mid * INDEX_ENTRY;
+        int c = memcmp(e, id->hash, OBJECT_ID_RAWSZ);
+        if (c == 0) {
+            Reader rd = { e + OBJECT_ID_RAWSZ, e + INDEX_ENTRY, 1 };
+            return rd_uint(&rd, 8);
+        }
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return 0;
+}
+
+int pack_contains(const ObjectId *id) {
+    return pack_map && find_offset(id) != 0;
+}
+
+uint32_t pack_object_count(void) {
+    return pack_map ? pack_count : 0;
+}
+
+int pack_object_id(uint32_t i, ObjectId *out) {
+    if (!pack_map || i >= pack_count) return -1;
+    memcpy(out->hash, pack_index + (size_t)i * INDEX_ENTRY, OBJECT_ID_RAWSZ);
+    return 0;
+}
+
+size_t pack_file_size(void) {
+    return pack_map ? pack_len : 0;
+}
+
+static unsigned char *read_entry(uint64_t offset, size_t *size, int depth) {
+    if (depth > PACK_MAX_DELTA_DEPTH || offset < 9 || offset >= pack_len) return NULL;
+
+    Reader rd = { pack_map + offset, pack_map + pack_len - TRAILER_SIZE, 1 };
+    int type = (int)rd_uint(&rd, 1);
+    size_t obj_size = (size_t)rd_varint(&rd);
+    uint64_t base_off = type == ENTRY_DELTA ? rd_uint(&rd, 8) : 0;
+    size_t payload_len = (size_t)rd_varint(&rd);
+    const unsigned char *payload = rd_bytes(&rd, payload_len);
+    if (!rd.ok) return NULL;
+
+    if (type == ENTRY_FULL) {
+        if (payload_len != obj_size) return NULL;
+        unsigned char *out = malloc(obj_size + 1);
+        if (!out) return NULL;
+        memcpy(out, payload, obj_size);
+        out[obj_size] = '\0';
+        *size = obj_size;
+        return out;
+    }
+    if (type != ENTRY_DELTA || base_off >= offset) return NULL;   // bases come first
+
+    size_t base_size = 0;
+    unsigned char *base = read_entry(base_off, &base_size, depth + 1);
+    if (!base) return NULL;
+
+    unsigned char *out = delta_apply(base, base_size, payload, payload_len, size);
+    free(base);
+    if (out && *size != obj_size) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+unsigned char *pack_read_object(const ObjectId *id, size_t *size) {
+    if (!pack_map) return NULL;
+    uint64_t off = find_offset(id);
+    return off ? read_entry(off, size, 0) : NULL;
+}
+
+/* =============== WRITING =================== */
+
+typedef struct IndexEntry {
+    ObjectId id;
+    uint64_t offset;
+} IndexEntry;
+
+static int cmp_index_entry(const void *a, const void *b) {
+    return memcmp(((const IndexEntry *)a)->id.hash,
+                  ((const IndexEntry *)b)->id.hash, OBJECT_ID_RAWSZ);
+}
+
+int pack_write(const char *pack_dir, Blob **blobs, const int *chain_id,
+               int count, PackStats *stats) {
+    struct stat st;
+    if (stat(pack_dir, &st) == -1 && mkdir(pack_dir, 0700) != 0) return -1;
+
+    IndexEntry *index = count ? malloc((size_t)count * sizeof(IndexEntry)) : NULL;
+    if (count && !index) return -1;
+
+    PackStats ps = {0};
+    ByteBuf out = {0};
+    buf_put(&out, PACK_MAGIC, 8);
+    buf_put_uint(&out, PACK_VERSION, 1);
+
+    const unsigned char *prev_data = NULL;
+    size_t prev_size = 0;
+    uint64_t prev_off = 0;
+    int depth = 0;
+
+    for (int i = 0; i < count; i++) {
+        const unsigned char *data = blob_data(blobs[i]);
+        if (!data) {
+            printf("Error: object for blob #%d is missing, repack aborted.\n", i);
+            free(index);
+            buf_free(&out);
+            return -1;
+        }
+        size_t size = blobs[i]->size;
+
+        /* A new chain (or a full-depth one) starts with a full entry */
+        if (i == 0 || chain_id[i] != chain_id[i - 1]) {
+            prev_data = NULL;
+            depth = 0;
+        }
+
+        unsigned char *delta = NULL;
+        size_t delta_len = 0;
+        if (prev_data && depth < PACK_MAX_DELTA_DEPTH)
+            delta = delta_create(prev_data, prev_size, data, size, size * 3 / 4, &delta_len);
+
+        uint64_t offset = out.len;
+        if (delta) {
+            buf_put_uint(&out, ENTRY_DELTA, 1);
+            buf_put_varint(&out, size);
+            buf_put_uint(&out, prev_off, 8);
+            buf_put_varint(&out, delta_len);
+            buf_put(&out, delta, delta_len);
+            free(delta);
+            depth++;
+            ps.deltas++;
+        } else {
+            buf_put_uint(&out, ENTRY_FULL, 1);
+            buf_put_varint(&out, size);
+            buf_put_varint(&out, size);
+            buf_put(&out, data, size);
+            depth = 0;
+        }
+
+        index[i].id = blobs[i]->id;
+        index[i].offset = offset;
+        ps.objects++;
+        ps.raw_bytes += size;
+
+        /* Keep only the previous version in memory */
+        if (i > 0 && prev_data) blob_evict(blobs[i - 1]);
+        prev_data = data;
+        prev_size = size;
+        prev_off = offset;
+    }
+    if (count > 0) blob_evict(blobs[count - 1]);
+
+    qsort(index, (size_t)count, sizeof(IndexEntry), cmp_index_entry);
+
+    uint64_t index_off = out.len;
+    for (int i = 0; i < count; i++) {
+        buf_put(&out, index[i].id.hash, OBJECT_ID_RAWSZ);
+        buf_put_uint(&out, index[i].offset, 8);
+    }
+    buf_put_uint(&out, index_off, 8);
+    buf_put_uint(&out, (uint32_t)count, 4);
+    buf_put(&out, TRAILER_MAGIC, 4);
+    free(index);
+
+    if (out.failed) {
+        buf_free(&out);
+        return -1;
+    }
+
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", pack_dir, PACK_FILE_NAME);
+
+    /* The old mapping stays valid until we reopen: rename is atomic */
+    int rc = write_file_atomic(path, out.data, out.len);
+    ps.pack_bytes = out.len;
+    buf_free(&out);
+    if (rc != 0) return -1;
+
+    if (stats) *stats = ps;
+    return pack_open(pack_dir);
+}
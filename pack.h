@@ -0,0 +1,55 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "object_store.h"
+
+/* Pack file: every packed object in one file, written atomically.
+ *
+ *   header   "MGITPACK" version(1)
+ *   entries  type(1) size(varint) [base offset(8) if delta] len(varint) payload
+ *   index    count x { hash(20) offset(8) }, sorted by hash
+ *   trailer  index offset(8) count(4) "MGPK"
+ *
+ * A file's history is stored newest first: the newest version in full,
+ * each older version as a binary delta against the next newer one, with
+ * chains cut every PACK_MAX_DELTA_DEPTH entries so reads stay cheap.
+ */
+#define PACK_FILE_NAME       "pack.mgp"
+#define PACK_MAX_DELTA_DEPTH 10
+
+typedef struct PackStats {
+    int objects;
+    int deltas;
+    size_t raw_bytes;             // sum of object sizes
+    size_t pack_bytes;            // size of the written pack
+} PackStats;
+
+int  pack_open(const char *pack_dir);
+void pack_close(void);
+int  pack_contains(const ObjectId *id);
+
+/* Objects in the open pack, in index (hash) order */
+uint32_t pack_object_count(void);
+int  pack_object_id(uint32_t i, ObjectId *out);              // 0 on success
+size_t pack_file_size(void);
+
+/* Read and resolve an object (following its delta chain).
+   Returns a malloc'd, NUL-terminated buffer or NULL. */
+unsigned char *pack_read_object(const ObjectId *id, size_t *size);
+
+/* Replace the pack with the given blobs. chain_id[i] groups blobs into
+   file histories; blobs of one chain must be consecutive, newest first. */
+int  pack_write(const char *pack_dir, Blob **blobs, const int *chain_id,
+                int count, PackStats *stats);
+
+/* -------- Binary deltas (copy/insert instructions) -------- */
+unsigned char *delta_create(const unsigned char *base, size_t base_len,
+                            const unsigned char *target, size_t target_len,
+                            size_t max_delta, size_t *delta_len);
+unsigned char *delta_apply(const unsigned char *base, size_t base_len,
+                           const unsigned char *delta, size_t delta_len,
+                           size_t *out_len);
+
+#endif /* PACK_H */
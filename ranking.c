@@ -10,6 +10,7 @@
  */
 
 #include "ranking.h"
+#include "topk.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,7 +24,11 @@ static ranking_stats_t g_ranking_stats = {0};
 static bool g_ranking_initialized = false;
 
 /* Internal helper functions */
-static int compare_search_results(const void *a, const void *b);
+static void score_documents(const char *query, search_result_t *documents,
+                            int num_documents, const query_context_t *context);
+static void update_ranking_stats(int num_documents, clock_t start_time);
+static void move_to_front(search_result_t *documents, ScoredDoc *winners, size_t k,
+                          unsigned char *placed);
 static float calculate_combined_score(const char *query, const search_result_t *document, 
                                      const document_features_t *features, const query_context_t *context);
 static int tokenize_query(const char *query, char tokens[][64], int max_tokens);
@@ -79,10 +84,17 @@ void cleanup_ranking_system(void) {
 
 /**
  * @brief Rank search results based on query and configuration
+ *
+ * Every document is scored, but only (score, index) pairs go through a
+ * bounded heap, O(n log k), and just the k winners are swapped into
+ * documents[0..k), best first; pass k = num_documents for a full order.
+ * Every document stays in the array; the order past the first k is
+ * unspecified.
+ * @return number of documents ranked at the front, -1 on error
  */
-int rank_search_results(const char *query, search_result_t *documents, 
-                       int num_documents, const query_context_t *context) {
-    if (!query || !documents || num_documents <= 0) {
+int rank_search_results(const char *query, search_result_t *documents,
+                        int num_documents, int k, const query_context_t *context) {
+    if (!query || !documents || num_documents <= 0 || k < 0) {
         return -1;
     }
     
@@ -93,34 +105,30 @@ int rank_search_results(const char *query, search_result_t *documents,
     
     clock_t start_time = clock();
     
-    // Calculate relevance scores for all documents
-    for (int i = 0; i < num_documents; i++) {
-        document_features_t features = {0};
-        
-        // Extract features from document
-        extract_document_features(&documents[i], query, &features);
-        
-        // Calculate combined score
-        documents[i].relevance_score = calculate_combined_score(query, &documents[i], &features, context);
-        
-        // Apply minimum threshold
-        if (documents[i].relevance_score < g_ranking_config.min_relevance_threshold) {
-            documents[i].relevance_score = 0.0;
-        }
+    if (k > num_documents) k = num_documents;
+    ScoredDoc *best = malloc((size_t)(k ? k : 1) * sizeof(ScoredDoc));
+    unsigned char *placed = malloc((size_t)(k ? k : 1));
+    if (!best || !placed) {
+        free(best);
+        free(placed);
+        return -1;
     }
     
-    // Sort documents by relevance score (descending)
-    qsort(documents, num_documents, sizeof(search_result_t), compare_search_results);
+    score_documents(query, documents, num_documents, context);
     
-    // Update statistics
-    clock_t end_time = clock();
-    double ranking_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC * 1000.0;
+    TopK top;
+    topk_init(&top, best, k);
+    for (int i = 0; i < num_documents; i++) {
+        topk_push(&top, documents[i].relevance_score, (uint32_t)i);
+    }
     
-    g_ranking_stats.total_documents_ranked += num_documents;
-    g_ranking_stats.queries_processed++;
-    g_ranking_stats.avg_ranking_time = (g_ranking_stats.avg_ranking_time * (g_ranking_stats.queries_processed - 1) + ranking_time) / g_ranking_stats.queries_processed;
+    int count = topk_finish(&top);
+    move_to_front(documents, best, (size_t)count, placed);
+    free(placed);
+    free(best);
     
-    return 0;
+    update_ranking_stats(num_documents, start_time);
+    return count;
 }
 
 /**
@@ -327,15 +335,78 @@ float calculate_semantic_similarity(const char *query, const search_result_t *do
 /* Internal helper function implementations */
 
 /**
- * @brief Compare search results for qsort (descending by relevance)
+ * @brief Set the relevance score of every document
+ */
+static void score_documents(const char *query, search_result_t *documents,
+                            int num_documents, const query_context_t *context) {
+    for (int i = 0; i < num_documents; i++) {
+        document_features_t features = {0};
+        
+        // Extract features from document
+        extract_document_features(&documents[i], query, &features);
+        
+        // Calculate combined score
+        documents[i].relevance_score = calculate_combined_score(query, &documents[i], &features, context);
+        
+        // Apply minimum threshold
+        if (documents[i].relevance_score < g_ranking_config.min_relevance_threshold) {
+            documents[i].relevance_score = 0.0;
+        }
+    }
+}
+
+/**
+ * @brief Account one ranking call in the statistics
+ */
+static void update_ranking_stats(int num_documents, clock_t start_time) {
+    clock_t end_time = clock();
+    double ranking_time = ((double)(end_time - start_time)) / CLOCKS_PER_SEC * 1000.0;
+    
+    g_ranking_stats.total_documents_ranked += num_documents;
+    g_ranking_stats.queries_processed++;
+    g_ranking_stats.avg_ranking_time = (g_ranking_stats.avg_ranking_time * (g_ranking_stats.queries_processed - 1) + ranking_time) / g_ranking_stats.queries_processed;
+}
+
+/**
+ * @brief Swap the k winners (indices into documents, best first) into
+ * documents[0..k) in that order
+ *
+ * Winners from past the front first trade places with front documents
+ * that lost; the front is then permuted in place by following cycles.
+ * placed is k bytes of scratch.
  */
-static int compare_search_results(const void *a, const void *b) {
-    const search_result_t *result_a = (const search_result_t*)a;
-    const search_result_t *result_b = (const search_result_t*)b;
+static void move_to_front(search_result_t *documents, ScoredDoc *winners, size_t k,
+                          unsigned char *placed) {
+    memset(placed, 0, k);
+    for (size_t r = 0; r < k; r++) {
+        if (winners[r].doc < k) placed[winners[r].doc] = 1;
+    }
     
-    if (result_a->relevance_score > result_b->relevance_score) return -1;
-    if (result_a->relevance_score < result_b->relevance_score) return 1;
-    return 0;
+    size_t hole = 0;
+    for (size_t r = 0; r < k; r++) {
+        if (winners[r].doc < k) continue;
+        while (placed[hole]) hole++;
+        search_result_t tmp = documents[hole];
+        documents[hole] = documents[winners[r].doc];
+        documents[winners[r].doc] = tmp;
+        winners[r].doc = (uint32_t)hole;
+        placed[hole] = 1;
+    }
+    
+    // Position r takes the document at winners[r].doc
+    memset(placed, 0, k);
+    for (size_t r = 0; r < k; r++) {
+        if (placed[r]) continue;
+        search_result_t first = documents[r];
+        size_t j = r;
+        while (winners[j].doc != r) {
+            documents[j] = documents[winners[j].doc];
+            placed[j] = 1;
+            j = winners[j].doc;
+        }
+        documents[j] = first;
+        placed[j] = 1;
+    }
 }
 
 /**
@@ -82,7 +82,7 @@ typedef struct {
 /* Core functions */
 int init_ranking_system(void);
 void cleanup_ranking_system(void);
-int rank_search_results(const char *query, search_result_t *documents, int num_documents, const query_context_t *context);
+int rank_search_results(const char *query, search_result_t *documents, int num_documents, int k, const query_context_t *context);
 float calculate_relevance_score(const char *query, const search_result_t *document, const document_features_t *features);
 
 /* Algorithm-specific scoring */
@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "repo_store.h"
+#include "object_store.h"
+#include "bytebuf.h"
+#include "wal.h"
+#include "codec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // mkdir, fstat
+
+#define HEADER_SIZE 12  // magic(7) + version(1) + record count(4)
+
+/* =============== LAYOUT =================== */
+
+int repo_store_ensure_layout(void) {
+    struct stat st;
+    if (stat(REPO_DIR, &st) == -1 && mkdir(REPO_DIR, 0700) != 0) {
+        printf("Error: cannot create %s/\n", REPO_DIR);
+        return -1;
+    }
+    if (stat(REPO_OBJECTS_DIR, &st) == -1 && mkdir(REPO_OBJECTS_DIR, 0700) != 0) {
+        printf("Error: cannot create %s/\n", REPO_OBJECTS_DIR);
+        return -1;
+    }
+    return 0;
+}
+
+/* =============== CONFIG =================== */
+
+void repo_store_load_config(RepoConfig *cfg) {
+    cfg->compression_level = CODEC_DEFAULT_LEVEL;
+    cfg->compression_dict = 0;
+
+    FILE *fp = fopen(REPO_CONFIG, "r");
+    if (!fp) return;
+
+    char line[256], key[64];
+    while (fgets(line, sizeof(line), fp)) {
+        char value[64];
+        if (line[0] == '#' || sscanf(line, " %63[^= ] = %63s", key, value) != 2)
+            continue;
+        if (strcmp(key, "compression.level") == 0)
+            cfg->compression_level = atoi(value);
+        else if (strcmp(key, "compression.dict") == 0)
+            cfg->compression_dict = (uint32_t)strtoul(value, NULL, 16);
+    }
+    fclose(fp);
+}
+
+int repo_store_save_config(const RepoConfig *cfg) {
+    char text[256];
+    int len = snprintf(text, sizeof(text),
+                       "compression.level = %d\n"
+                       "compression.dict = %08x\n",
+                       cfg->compression_level, (unsigned)cfg->compression_dict);
+    return write_file_atomic(REPO_CONFIG, text, (size_t)len);
+}
+
+/* =============== LOAD =================== */
+
+/* Records are variable length; the Commit is laid out in the repo arena */
+static Commit *parse_commit_record(Reader *rd, Arena *arena) {
+    int commit_id = (int)rd_uint(rd, 4);
+    int parent_id = (int)rd_uint(rd, 4);
+    long timestamp = (long)(int64_t)rd_uint(rd, 8);
+    size_t msg_len = (size_t)rd_uint(rd, 4);
+    uint32_t file_count = (uint32_t)rd_uint(rd, 4);
+    const unsigned char *msg = rd_bytes(rd, msg_len);
+
+    /* Every file entry takes at least 30 bytes: reject absurd counts early */
+    if (!rd->ok || file_count > (size_t)(rd->end - rd->p) / 30) {
+        rd->ok = 0;
+        return NULL;
+    }
+
+    Commit *c = arena_alloc(arena, sizeof(Commit));
+    CommitFile *files = file_count
+        ? arena_alloc(arena, file_count * sizeof(CommitFile))
+        : NULL;
+    const char *message = arena_strndup(arena, (const char *)msg, msg_len);
+    if (!c || (file_count && !files) || !message) return NULL;
+
+    c->commit_id = commit_id;
+    c->parent_id = parent_id;
+    c->timestamp = timestamp;
+    c->message = message;
+    c->files = files;
+    c->file_count = 0;
+
+    for (uint32_t i = 0; i < file_count; i++) {
+        ObjectId id;
+        const unsigned char *hash = rd_bytes(rd, OBJECT_ID_RAWSZ);
+        size_t size = (size_t)rd_uint(rd, 8);
+        size_t name_len = (size_t)rd_uint(rd, 2);
+        const unsigned char *name = rd_bytes(rd, name_len);
+        if (!rd->ok) break;
+
+        CommitFile *cf = &c->files[c->file_count];
+        cf->filename = arena_strndup(arena, (const char *)name, name_len);
+
+        memcpy(id.hash, hash, OBJECT_ID_RAWSZ);
+        cf->blob = object_store_ref(&id, size);
+        if (cf->filename && cf->blob) c->file_count++;
+    }
+
+    if (!rd->ok) {
+        for (int i = 0; i < c->file_count; i++)
+            blob_release(c->files[i].blob);
+        return NULL;
+    }
+    return c;
+}
+
+Commit *repo_store_decode_commit(const unsigned char *p, size_t len, Arena *arena) {
+    Reader rd = { p, p + len, 1 };
+    Commit *c = parse_commit_record(&rd, arena);
+    return c && rd.ok ? c : NULL;
+}
+
+int repo_store_log_commit_id(const unsigned char *p, size_t len) {
+    if (len < 4) return -1;
+    return (int)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                 (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+int repo_store_load(Repository *r) {
+    int fd = open(REPO_COMMITS, O_RDONLY);
+    if (fd < 0) return 0;            // fresh repository
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size < HEADER_SIZE) {
+        close(fd);
+        return st.st_size == 0 ? 0 : -1;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    Reader rd = { (const unsigned char *)map, (const unsigned char *)map + len, 1 };
+
+    const unsigned char *magic = rd_bytes(&rd, 7);
+    int version = (int)rd_uint(&rd, 1);
+    uint32_t count = (uint32_t)rd_uint(&rd, 4);
+
+    if (!rd.ok || memcmp(magic, COMMIT_TABLE_MAGIC, 7) != 0 ||
+        version != COMMIT_TABLE_VERSION) {
+        munmap(map, len);
+        return -1;
+    }
+
+    /* Records are stored oldest first; prepend to keep newest at head */
+    int loaded = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        Commit *c = parse_commit_record(&rd, &r->arena);
+        if (!c) break;
+
+        c->next = r->head;
+        c->prev = NULL;
+        if (r->head) r->head->prev = c;
+        r->head = c;
+        if (c->commit_id > r->commit_count)
+            r->commit_count = c->commit_id;
+        loaded++;
+    }
+
+    munmap(map, len);
+    return (uint32_t)loaded == count ? loaded : -1;
+}
+
+/* =============== SAVE =================== */
+
+void repo_store_encode_commit(ByteBuf *b, const Commit *c) {
+    size_t msg_len = strlen(c->message);
+
+    buf_put_uint(b, (uint32_t)c->commit_id, 4);
+    buf_put_uint(b, (uint32_t)c->parent_id, 4);
+    buf_put_uint(b, (uint64_t)(int64_t)c->timestamp, 8);
+    buf_put_uint(b, msg_len, 4);
+    buf_put_uint(b, (uint32_t)c->file_count, 4);
+    buf_put(b, c->message, msg_len);
+
+    for (int i = 0; i < c->file_count; i++) {
+        const CommitFile *cf = &c->files[i];
+        size_t name_len = strlen(cf->filename);
+
+        buf_put(b, cf->blob->id.hash, OBJECT_ID_RAWSZ);
+        buf_put_uint(b, cf->blob->size, 8);
+        buf_put_uint(b, name_len, 2);
+        buf_put(b, cf->filename, name_len);
+    }
+}
+
+static void encode_commits_oldest_first(ByteBuf *b, const Commit *c, uint32_t *count) {
+    /* Iterative reversal: collect pointers, then emit backwards */
+    size_t n = 0, cap = 64;
+    const Commit **stack = malloc(cap * sizeof(*stack));
+    if (!stack) return;
+
+    for (; c; c = c->next) {
+        if (n == cap) {
+            const Commit **p = realloc(stack, cap * 2 * sizeof(*stack));
+            if (!p) break;
+            stack = p;
+            cap *= 2;
+        }
+        stack[n++] = c;
+    }
+    while (n > 0) {
+        repo_store_encode_commit(b, stack[--n]);
+        (*count)++;
+    }
+    free(stack);
+}
+
+int repo_store_save(const Repository *r) {
+    ByteBuf b = {0};
+    uint32_t count = 0;
+
+    buf_put(&b, COMMIT_TABLE_MAGIC, 7);
+    buf_put_uint(&b, COMMIT_TABLE_VERSION, 1);
+    buf_put_uint(&b, 0, 4);                       // patched below
+    encode_commits_oldest_first(&b, r->head, &count);
+
+    if (b.failed || b.len < HEADER_SIZE) {
+        buf_free(&b);
+        return -1;
+    }
+    for (int i = 0; i < 4; i++)
+        b.data[8 + i] = (unsigned char)(count >> (8 * i));
+
+    /* Temp file + rename so readers never see a torn table */
+    int rc = write_file_atomic(REPO_COMMITS, b.data, b.len);
+    buf_free(&b);
+    return rc;
+}
+
+/* =============== WRITE-AHEAD LOG =================== */
+
+int repo_store_open_log(void) {
+    return wal_open(REPO_WAL);
+}
+
+int repo_store_checkpoint(const Repository *r) {
+    /* The table must never reference objects that could still be lost */
+    if (object_store_sync() != 0) return -1;
+    if (repo_store_save(r) != 0) return -1;
+    if (commit_graph_write(&r->graph, REPO_COMMIT_GRAPH) != 0) return -1;
+    return wal_reset();
+}
+
+/* Group commit: objects and log are flushed together, once per batch */
+static int log_record(const Repository *r, int type, const ByteBuf *b) {
+    if (b->failed || wal_append(type, b->data, b->len) != 0)
+        return repo_store_checkpoint(r);         // no log: fall back to the table
+
+    if (wal_size() > WAL_CHECKPOINT_BYTES)
+        return repo_store_checkpoint(r);
+
+    return repo_store_sync_due();
+}
+
+int repo_store_sync_due(void) {
+    if (!wal_sync_due()) return 0;
+    if (object_store_sync() != 0) return -1;
+    return wal_sync();
+}
+
+int repo_store_sync_wait_ms(void) {
+    return wal_sync_wait_ms();
+}
+
+int repo_store_log_commit(const Repository *r, const Commit *c) {
+    ByteBuf b = {0};
+    repo_store_encode_commit(&b, c);
+    int rc = log_record(r, LOG_COMMIT, &b);
+    buf_free(&b);
+    return rc;
+}
+
+int repo_store_log_delete(const Repository *r, int commit_id) {
+    ByteBuf b = {0};
+    buf_put_uint(&b, (uint32_t)commit_id, 4);
+    int rc = log_record(r, LOG_DELETE, &b);
+    buf_free(&b);
+    return rc;
+}
@@ -0,0 +1,77 @@
+#ifndef REPO_STORE_H
+#define REPO_STORE_H
+
+#include "minigit.h"
+#include "bytebuf.h"
+
+/* On-disk layout:
+ *   .mgit/commits            commit table (all commit records, oldest first)
+ *   .mgit/wal                commits and deletes since the table was written
+ *   .mgit/commit-graph       parents, generations, messages (commit_graph.h)
+ *   .mgit/objects/xx/yyyy..  loose blobs named by their SHA-1 digest (".z": compressed)
+ *   .mgit/objects/dict/      compression dictionaries (object_store.h)
+ *   .mgit/index              stat cache of the working tree (work_index.h)
+ *   .mgit/config             per-repository settings, "key = value" lines
+ */
+#define REPO_DIR         ".mgit"
+#define REPO_OBJECTS_DIR ".mgit/objects"
+#define REPO_COMMITS     ".mgit/commits"
+#define REPO_INDEX       ".mgit/index"
+#define REPO_WAL         ".mgit/wal"
+#define REPO_COMMIT_GRAPH ".mgit/commit-graph"
+#define REPO_CONFIG      ".mgit/config"
+
+#define COMMIT_TABLE_MAGIC   "MGITCMT"
+#define COMMIT_TABLE_VERSION 1
+
+/* WAL record types; the log is folded into the table once it holds
+   more than WAL_CHECKPOINT_BYTES */
+#define LOG_COMMIT           1            // payload: commit record
+#define LOG_DELETE           2            // payload: commit_id(4)
+#define WAL_CHECKPOINT_BYTES (256 * 1024)
+
+/* Create .mgit/ and .mgit/objects/ if missing. Returns 0 on success. */
+int repo_store_ensure_layout(void);
+
+/* -------- Settings kept in .mgit/config -------- */
+typedef struct RepoConfig {
+    int compression_level;        // compression.level: 0 stores objects raw
+    uint32_t compression_dict;    // compression.dict: dictionary id, 0 for none
+} RepoConfig;
+
+/* Missing file or keys leave the defaults; unknown keys are ignored */
+void repo_store_load_config(RepoConfig *cfg);
+int  repo_store_save_config(const RepoConfig *cfg);   // 0 on success
+
+/* Map the commit table and rebuild repo->head (blobs are loaded lazily).
+   Returns number of commits loaded, or -1 if the table is corrupt. */
+int repo_store_load(Repository *r);
+
+/* Atomically rewrite the commit table from repo->head. Returns 0 on success. */
+int repo_store_save(const Repository *r);
+
+/* One commit record, as stored in the table and the WAL */
+void    repo_store_encode_commit(ByteBuf *b, const Commit *c);
+Commit *repo_store_decode_commit(const unsigned char *p, size_t len, Arena *arena);
+
+/* The commit a WAL record (either type) is about; -1 if it is too short */
+int     repo_store_log_commit_id(const unsigned char *p, size_t len);
+
+/* Open .mgit/wal; records in it are applied by the caller via wal_replay() */
+int repo_store_open_log(void);
+
+/* Log a change durably enough to survive a crash (group-committed fsync),
+   checkpointing into the table when the log grows large. 0 on success. */
+int repo_store_log_commit(const Repository *r, const Commit *c);
+int repo_store_log_delete(const Repository *r, int commit_id);
+
+/* For event loops: sync logged changes whose group commit window has
+   expired (0 on success), and the ms until that is due (0: now, -1 if
+   nothing is pending) */
+int repo_store_sync_due(void);
+int repo_store_sync_wait_ms(void);
+
+/* Sync objects, rewrite the table and commit-graph from r, then empty the log */
+int repo_store_checkpoint(const Repository *r);
+
+#endif /* REPO_STORE_H */
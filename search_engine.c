@@ -6,15 +6,26 @@
 #include "search_engine.h"
 #include "autocomplete.h"
 #include "ranking.h"
+#include "span.h"
+#include "inverted_index.h"
+#include "arena.h"
+#include "topk.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <math.h>
 
 /* ---------- CONFIG ---------- */
 
-#define MAX_DOCUMENTS 100
+#define DOC_CHUNK_SHIFT 10
+#define DOC_CHUNK_SIZE (1 << DOC_CHUNK_SHIFT)   /* documents per chunk */
+#define MAX_QUERY_TERMS 16
+#define TITLE_WEIGHT 3            /* a title hit counts as three body hits */
+#define SNIPPET_LENGTH 160        /* description kept for display */
+#define BINARY_PROBE 8000         /* a NUL this early marks a binary file */
+#define BOUND_SLACK 1.0001f       /* bounds round up, so float error never prunes a winner */
 
 /* ---------- GLOBAL STATE ---------- */
 
@@ -24,19 +35,33 @@ static int    g_total_documents   = 0;
 static int    g_total_queries     = 0;
 static double g_avg_response_time = 0.0;
 
-static search_result_t g_documents[MAX_DOCUMENTS];
+/* ---------- DOCUMENT STORE ---------- */
+/* Documents are kept compact (strings in an arena) in fixed-size
+   chunks that never move once allocated, so a document's slot, its id
+   (slot + 1) and its address stay the same however many are added.
+   A search_result_t is filled in only for the documents a query
+   returns. The whole body of a document goes into the inverted index;
+   only a short snippet of it is stored, for display. */
+typedef struct {
+    const char *title;
+    const char *description;
+    const char *url;
+    long timestamp;
+    int click_count;
+    float authority_score;
+} stored_doc_t;
+
+static stored_doc_t **g_doc_chunks = NULL;
+static int g_chunk_count = 0;
+static int g_chunk_cap = 0;
 static int g_document_count = 0;
+static Arena g_doc_strings;
 
-/* ---------- GLOBAL COMPARATOR (ONLY ONE) ---------- */
+/* Postings point at document slots */
+static InvertedIndex g_index;
 
-static int cmp_results_descending(const void *a, const void *b) {
-    const search_result_t *ra = (const search_result_t *)a;
-    const search_result_t *rb = (const search_result_t *)b;
-
-    if (ra->relevance_score < rb->relevance_score) return 1;
-    if (ra->relevance_score > rb->relevance_score) return -1;
-    return 0;
-}
+/* Per-query scratch, emptied (not freed) at the start of each query */
+static Arena g_query_arena;
 
 /* ---------- INTERNAL HELPERS ---------- */
 /* Highlight all occurrences of the query inside the line using ANSI color */
@@ -94,64 +119,135 @@ static void to_lower_inplace(char *s) {
             s[i] = (char)(s[i] - 'A' + 'a');
     }
 }
-/* Add a prebuilt document (like commit message) to search engine */
-void add_document_to_search_engine_virtual(const search_result_t *doc) {
-    if (g_document_count >= MAX_DOCUMENTS) return;
+static stored_doc_t *doc_at(uint32_t slot) {
+    return &g_doc_chunks[slot >> DOC_CHUNK_SHIFT][slot & (DOC_CHUNK_SIZE - 1)];
+}
 
-    g_documents[g_document_count] = *doc;
-    g_document_count++;
-    g_total_documents = g_document_count;
+/* The next free slot, with a chunk allocated for it; NULL if out of memory */
+static stored_doc_t *doc_next_slot(void) {
+    int chunk = g_document_count >> DOC_CHUNK_SHIFT;
+    if (chunk == g_chunk_count) {
+        if (g_chunk_count == g_chunk_cap) {
+            int cap = g_chunk_cap ? g_chunk_cap * 2 : 16;
+            stored_doc_t **p = realloc(g_doc_chunks, (size_t)cap * sizeof(*p));
+            if (!p) return NULL;
+            g_doc_chunks = p;
+            g_chunk_cap = cap;
+        }
+        g_doc_chunks[chunk] = malloc(DOC_CHUNK_SIZE * sizeof(stored_doc_t));
+        if (!g_doc_chunks[chunk]) return NULL;
+        g_chunk_count++;
+    }
+    return doc_at((uint32_t)g_document_count);
 }
 
-static int count_occurrences(const char *text, const char *term) {
-    if (!*term) return 0;
-    int count = 0;
-    const char *p = text;
-    size_t term_len = strlen(term);
+static void materialize_document(uint32_t slot, search_result_t *out) {
+    const stored_doc_t *doc = doc_at(slot);
+    snprintf(out->title, sizeof(out->title), "%s", doc->title);
+    snprintf(out->description, sizeof(out->description), "%s", doc->description);
+    snprintf(out->url, sizeof(out->url), "%s", doc->url);
+    out->relevance_score = 0.0f;
+    out->document_id     = (int)slot + 1;
+    out->timestamp       = doc->timestamp;
+    out->click_count     = doc->click_count;
+    out->authority_score = doc->authority_score;
+}
 
-    while ((p = strstr(p, term)) != NULL) {
-        count++;
-        p += term_len;
-    }
-    return count;
+/* Post the title and body of the document in slot to the inverted index */
+static void index_document(uint32_t slot, const char *body, size_t body_len) {
+    const stored_doc_t *doc = doc_at(slot);
+
+    if (inverted_index_add(&g_index, slot, doc->title,
+                           strlen(doc->title), TITLE_WEIGHT) != 0 ||
+        inverted_index_add(&g_index, slot, body, body_len, 1) != 0)
+        fprintf(stderr, "Warning: search index out of memory, '%s' partly indexed\n",
+                doc->title);
 }
 
-/* ---------- ADD DOCUMENT ---------- */
+/* Length of the display snippet of text: at most SNIPPET_LENGTH bytes,
+   cut after a space or newline when the text goes on */
+static size_t snippet_length(const char *text, size_t len) {
+    if (len <= SNIPPET_LENGTH) return len;
+    size_t cut = SNIPPET_LENGTH;
+    while (cut > SNIPPET_LENGTH / 2 && text[cut - 1] != ' ' && text[cut - 1] != '\n')
+        cut--;
+    return cut > SNIPPET_LENGTH / 2 ? cut : SNIPPET_LENGTH;
+}
 
-void add_document_to_search_engine(const char *filename) {
-    if (!filename) return;
-    if (g_document_count >= MAX_DOCUMENTS) {
-        printf("[DEBUG] Document limit reached.\n");
-        return;
-    }
+/* Store a document with a snippet of body as its description and index
+   all of body; -1 if memory ran out */
+static int store_document(const char *title, const char *snippet, size_t snippet_len,
+                          const char *body, size_t body_len,
+                          const char *url, long timestamp) {
+    stored_doc_t *doc = doc_next_slot();
+    if (!doc) return -1;
+
+    doc->title           = arena_strdup(&g_doc_strings, title);
+    doc->description     = arena_strndup(&g_doc_strings, snippet, snippet_len);
+    doc->url             = arena_strdup(&g_doc_strings, url);
+    doc->timestamp       = timestamp;
+    doc->click_count     = 0;
+    doc->authority_score = 0.0f;
+    if (!doc->title || !doc->description || !doc->url) return -1;
+
+    index_document((uint32_t)g_document_count, body, body_len);
+    g_document_count++;
+    g_total_documents = g_document_count;
+    return 0;
+}
 
-    printf("[DEBUG] Adding search document: %s\n", filename);
+/* Add a prebuilt document (like commit message) to search engine */
+void add_document_to_search_engine_virtual(const search_result_t *doc) {
+    size_t len = strlen(doc->description);
+    if (store_document(doc->title, doc->description, snippet_length(doc->description, len),
+                       doc->description, len, doc->url, doc->timestamp) != 0)
+        fprintf(stderr, "Warning: out of memory, '%s' not searchable\n", doc->title);
+}
 
-    search_result_t *doc = &g_documents[g_document_count];
+/* ---------- ADD DOCUMENT ---------- */
 
-    snprintf(doc->title, sizeof(doc->title), "%s", filename);
+static int add_file_document(const char *filename) {
+    Span span;
+    if (span_open_file(filename, &span) != 0) {
+        char msg[MAX_DESCRIPTION_LENGTH];
+        snprintf(msg, sizeof(msg), "(Could not read file '%s')", filename);
+        return store_document(filename, msg, strlen(msg), "", 0,
+                              "local-file", (long)time(NULL));
+    }
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        snprintf(doc->description, sizeof(doc->description),
-                 "(Could not read file '%s')", filename);
+    /* Binary files are found by name only */
+    const char *data = (const char *)span.data;
+    size_t probe = span.size < BINARY_PROBE ? span.size : BINARY_PROBE;
+    int rc;
+    if (memchr(data, '\0', probe)) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "(binary file, %zu bytes)", span.size);
+        rc = store_document(filename, msg, strlen(msg), "", 0,
+                            "local-file", (long)time(NULL));
     } else {
-        size_t n = fread(doc->description, 1,
-                         sizeof(doc->description) - 1, fp);
-        doc->description[n] = '\0';
-        fclose(fp);
+        rc = store_document(filename, data, snippet_length(data, span.size),
+                            data, span.size, "local-file", (long)time(NULL));
     }
+    span_close(&span);
+    return rc;
+}
 
-    snprintf(doc->url, sizeof(doc->url), "local-file");
+void add_document_to_search_engine(const char *filename) {
+    if (!filename) return;
+
+    printf("[DEBUG] Adding search document: %s\n", filename);
+    if (add_file_document(filename) != 0)
+        fprintf(stderr, "Warning: out of memory, '%s' not searchable\n", filename);
+}
 
-    doc->document_id      = g_document_count + 1;
-    doc->relevance_score  = 0.0f;
-    doc->timestamp        = (long)time(NULL);
-    doc->click_count      = 0;
-    doc->authority_score  = 0.0f;
+int add_documents_to_search_engine(const char *const *filenames, int count) {
+    int added = 0;
+    while (added < count && add_file_document(filenames[added]) == 0)
+        added++;
 
-    g_document_count++;
-    g_total_documents = g_document_count;
+    if (added < count)
+        fprintf(stderr, "Warning: out of memory, %d documents not searchable\n", count - added);
+    return added;
 }
 
 /* ---------- INIT ---------- */
@@ -176,6 +272,14 @@ int init_search_engine(void) {
 
 void cleanup_search_engine(void) {
     memset(&g_search_config, 0, sizeof(g_search_config));
+    inverted_index_free(&g_index);
+    for (int i = 0; i < g_chunk_count; i++)
+        free(g_doc_chunks[i]);
+    free(g_doc_chunks);
+    g_doc_chunks = NULL;
+    g_chunk_count = g_chunk_cap = 0;
+    arena_free_all(&g_doc_strings);
+    arena_free_all(&g_query_arena);
     g_document_count = 0;
     g_total_documents = 0;
     g_total_queries = 0;
@@ -187,10 +291,174 @@ void cleanup_search_engine(void) {
 
 int build_search_index(void) {
     printf("Building search index...\n");
-    printf("Search index built (%d documents).\n", g_total_documents);
+    printf("Search index built (%d documents, %d terms).\n",
+           g_total_documents, g_index.term_count);
     return 0;
 }
 
+/* ---------- BM25 + BLOCK-MAX WAND ---------- */
+/* Documents are ranked by Okapi BM25 over the weighted term counts.
+   Each query term gets a cursor over its postings and, for every block
+   of them, an upper bound on what the term adds to a document's score
+   (from the block's largest tf / norm). Once
+   max_results documents are held, Block-Max WAND (Ding & Suel) only
+   scores a document whose bounds beat the worst one kept, and jumps
+   over whole blocks that cannot, so most postings of a common term are
+   never read. */
+
+typedef struct {
+    const IndexTerm *term;
+    float idf;
+    float *block_bound;           /* per block, in the query arena */
+    uint32_t *block_last;         /* last document of each block, likewise */
+    int blocks;
+    float bound;                  /* largest block_bound */
+    int block;                    /* block of the last shallow move */
+    int pos;
+    uint32_t doc;                 /* postings[pos].doc, UINT32_MAX when used up */
+} term_cursor_t;
+
+/* What a term adds to a document's score, given tf / norm(doc length):
+   idf * tf * (K1 + 1) / (tf + norm), which grows with the ratio */
+static float bm25(float idf, float ratio) {
+    return idf * (BM25_K1 + 1.0f) * ratio / (1.0f + ratio);
+}
+
+/* Set up c over t; -1 if the query arena ran out */
+static int cursor_open(term_cursor_t *c, const IndexTerm *t) {
+    int blocks = (t->count + INDEX_BLOCK_SIZE - 1) >> INDEX_BLOCK_SHIFT;
+    float df = (float)t->count;
+
+    c->term = t;
+    c->idf = logf(1.0f + ((float)g_document_count - df + 0.5f) / (df + 0.5f));
+    c->block_bound = arena_alloc(&g_query_arena, (size_t)blocks * sizeof(float));
+    c->block_last = arena_alloc(&g_query_arena, (size_t)blocks * sizeof(uint32_t));
+    if (!c->block_bound || !c->block_last) return -1;
+    c->blocks = blocks;
+    c->bound = 0.0f;
+    for (int b = 0; b < blocks; b++) {
+        float ratio = inverted_index_block_ratio(&g_index, t, b);
+        int end = (b + 1) << INDEX_BLOCK_SHIFT;
+        c->block_bound[b] = bm25(c->idf, ratio) * BOUND_SLACK;
+        c->block_last[b] = t->postings[(end < t->count ? end : t->count) - 1].doc;
+        if (c->block_bound[b] > c->bound) c->bound = c->block_bound[b];
+    }
+    c->block = 0;
+    c->pos = 0;
+    c->doc = t->postings[0].doc;
+    return 0;
+}
+
+static void cursor_next(term_cursor_t *c) {
+    c->pos++;
+    c->doc = c->pos < c->term->count ? c->term->postings[c->pos].doc : UINT32_MAX;
+}
+
+/* Move c to its first posting at or after doc: block by block on the
+   last documents, then by binary search inside the block */
+static void cursor_seek(term_cursor_t *c, uint32_t doc) {
+    const IndexTerm *t = c->term;
+    if (c->doc >= doc) return;
+
+    int b = c->pos >> INDEX_BLOCK_SHIFT;
+    while (b < c->blocks && c->block_last[b] < doc) b++;
+    if (b == c->blocks) {
+        c->pos = t->count;
+        c->doc = UINT32_MAX;
+        return;
+    }
+    int lo = c->pos > (b << INDEX_BLOCK_SHIFT) ? c->pos : b << INDEX_BLOCK_SHIFT;
+    int hi = ((b + 1) << INDEX_BLOCK_SHIFT) - 1;
+    if (hi >= t->count) hi = t->count - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (t->postings[mid].doc < doc) lo = mid + 1;
+        else hi = mid;
+    }
+    c->pos = lo;
+    c->doc = t->postings[lo].doc;
+}
+
+/* Bound of the block that would hold doc, without moving the cursor;
+   *last gets the block's last document (UINT32_MAX past the end) */
+static float cursor_block_bound(term_cursor_t *c, uint32_t doc, uint32_t *last) {
+    if (c->block < (c->pos >> INDEX_BLOCK_SHIFT)) c->block = c->pos >> INDEX_BLOCK_SHIFT;
+    while (c->block < c->blocks && c->block_last[c->block] < doc) c->block++;
+    if (c->block == c->blocks) {
+        *last = UINT32_MAX;
+        return 0.0f;
+    }
+    *last = c->block_last[c->block];
+    return c->block_bound[c->block];
+}
+
+/* Keep cursors ordered by their current document */
+static void sort_cursors(term_cursor_t **order, int n) {
+    for (int i = 1; i < n; i++) {
+        term_cursor_t *c = order[i];
+        int j = i;
+        while (j > 0 && order[j - 1]->doc > c->doc) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = c;
+    }
+}
+
+/* Push every document that can still make it into top */
+static void block_max_wand(term_cursor_t *cursors, int n, TopK *top, float avg_len) {
+    term_cursor_t *order[MAX_QUERY_TERMS];
+    for (int i = 0; i < n; i++) order[i] = &cursors[i];
+
+    for (;;) {
+        sort_cursors(order, n);
+        float threshold = topk_threshold(top);
+
+        /* Pivot: the first document the term bounds let through. Any
+           document before it holds too few of the terms. */
+        float reach = 0.0f;
+        int p = -1;
+        for (int i = 0; i < n && order[i]->doc != UINT32_MAX; i++) {
+            reach += order[i]->bound;
+            if (reach > threshold) {
+                p = i;
+                break;
+            }
+        }
+        if (p < 0) break;
+        uint32_t pivot = order[p]->doc;
+        while (p + 1 < n && order[p + 1]->doc == pivot) p++;
+
+        /* Tighter test with the blocks holding the pivot; if it fails,
+           nothing up to the end of the nearest of those blocks passes */
+        uint32_t next = p + 1 < n ? order[p + 1]->doc : UINT32_MAX;
+        float block_reach = 0.0f;
+        for (int i = 0; i <= p; i++) {
+            uint32_t last;
+            block_reach += cursor_block_bound(order[i], pivot, &last);
+            if (last != UINT32_MAX && last + 1 < next) next = last + 1;
+        }
+        if (block_reach <= threshold) {
+            for (int i = 0; i <= p; i++) cursor_seek(order[i], next);
+            continue;
+        }
+
+        if (order[0]->doc != pivot) {
+            for (int i = 0; order[i]->doc < pivot; i++) cursor_seek(order[i], pivot);
+            continue;
+        }
+
+        float norm = inverted_index_norm(g_index.doc_lens[pivot], avg_len);
+        float score = 0.0f;
+        for (int i = 0; i <= p; i++) {
+            const Posting *post = &order[i]->term->postings[order[i]->pos];
+            score += bm25(order[i]->idf, (float)post->tf / norm);
+            cursor_next(order[i]);
+        }
+        topk_push(top, score, pivot);
+    }
+}
+
 /* ---------- SEARCH + RANK ---------- */
 
 int search_and_rank(const char *query, search_result_t *results, int max_results) {
@@ -207,87 +475,54 @@ int search_and_rank(const char *query, search_result_t *results, int max_results
         return 0;
     }
 
-    /* ---- 1. Split query into lowercase tokens ---- */
+    /* ---- 1. Split query into index terms, each looked up once ---- */
 
-    char query_copy[MAX_QUERY_LENGTH];
-    strncpy(query_copy, query, sizeof(query_copy)-1);
-    query_copy[sizeof(query_copy)-1] = '\0';
-    to_lower_inplace(query_copy);
+    const IndexTerm *terms[MAX_QUERY_TERMS];
+    int term_count = 0, token_count = 0;
 
-    char *tokens[16];
-    int token_count = 0;
+    const char *qp = query, *qend = query + strlen(query);
+    char term[INDEX_TERM_MAX + 1];
+    size_t len;
 
-    char *tok = strtok(query_copy, " ");
-    while (tok && token_count < 16) {
-        tokens[token_count++] = tok;
-        tok = strtok(NULL, " ");
+    while (token_count < MAX_QUERY_TERMS &&
+           (len = inverted_index_next_term(&qp, qend, term)) > 0) {
+        token_count++;
+        const IndexTerm *t = inverted_index_find(&g_index, term, len);
+        int seen = 0;
+        for (int k = 0; k < term_count; k++)
+            if (terms[k] == t) seen = 1;
+        if (t && !seen) terms[term_count++] = t;
     }
 
-    /* ---- 2. Prepare scoring ---- */
+    /* ---- 2. Score with BM25, pruning what cannot make the top ---- */
+    /* Only the best max_results are kept, as (score, slot) pairs */
 
-    search_result_t local[MAX_DOCUMENTS];
-    float scores[MAX_DOCUMENTS];
-    int n_local = 0;
+    arena_reset(&g_query_arena);
+    ScoredDoc *best = arena_alloc(&g_query_arena, (size_t)max_results * sizeof(ScoredDoc));
+    term_cursor_t cursors[MAX_QUERY_TERMS];
+    float avg_len = inverted_index_avg_len(&g_index);
 
-    for (int i = 0; i < g_document_count; i++) {
-
-        local[n_local] = g_documents[i];
-
-        char title_l[MAX_TITLE_LENGTH];
-        char desc_l[MAX_DESCRIPTION_LENGTH];
-
-        strncpy(title_l, g_documents[i].title, sizeof(title_l)-1);
-        title_l[sizeof(title_l)-1] = '\0';
-
-        strncpy(desc_l, g_documents[i].description, sizeof(desc_l)-1);
-        desc_l[sizeof(desc_l)-1] = '\0';
-
-        to_lower_inplace(title_l);
-        to_lower_inplace(desc_l);
-
-        float doc_score = 0.0f;
-        int words_matched = 0;
-
-        /* ---- 3. Score each token ---- */
-        for (int t = 0; t < token_count; t++) {
-            char *term = tokens[t];
-
-            int title_hits = count_occurrences(title_l, term);
-            int body_hits  = count_occurrences(desc_l,  term);
-
-            if (title_hits > 0 || body_hits > 0)
-                words_matched++;
-
-            doc_score += (float)(title_hits * 3 + body_hits); // weighted
-        }
-
-        /* ---- 4. Bonus: matching more words boosts rank ---- */
-        if (token_count > 1)
-            doc_score *= (1.0f + (float)words_matched / token_count);
-
-        scores[n_local] = doc_score;
-        n_local++;
+    int ok = best != NULL;
+    for (int k = 0; ok && k < term_count; k++)
+        ok = cursor_open(&cursors[k], terms[k]) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error: out of memory for query '%s'\n", query);
+        return 0;
     }
 
-    /* ---- 5. Normalize and sort ---- */
-
-    float max_raw = 0.0f;
-    for (int i = 0; i < n_local; i++)
-        if (scores[i] > max_raw) max_raw = scores[i];
-
-    if (max_raw < 0.001f)
-        max_raw = 0.001f;
-
-    for (int i = 0; i < n_local; i++)
-        local[i].relevance_score = scores[i] / max_raw;
+    TopK top;
+    topk_init(&top, best, max_results);
+    block_max_wand(cursors, term_count, &top, avg_len);
 
-    qsort(local, n_local, sizeof(search_result_t), cmp_results_descending);
+    /* ---- 3. Copy out only the winners, best first ---- */
 
-    int out_count = n_local < max_results ? n_local : max_results;
-    for (int i = 0; i < out_count; i++)
-        results[i] = local[i];
+    int out_count = topk_finish(&top);
+    for (int i = 0; i < out_count; i++) {
+        materialize_document(best[i].doc, &results[i]);
+        results[i].relevance_score = best[i].score / best[0].score;
+    }
 
-    /* ---- 6. Stats ---- */
+    /* ---- 4. Stats ---- */
 
     clock_t end_time = clock();
     double ms = ((double)(end_time - start_time)) / CLOCKS_PER_SEC * 1000.0;
@@ -311,17 +546,29 @@ void get_search_stats(int *t_docs, int *t_q, double *avg) {
     if (t_q)    *t_q    = g_total_queries;
     if (avg)    *avg    = g_avg_response_time;
 }
-/* Extract a line containing the search term from file */
+/* Case-insensitive search for a lowercase needle in [p, end) */
+static const unsigned char *find_nocase(const unsigned char *p, const unsigned char *end,
+                                        const char *needle, size_t len) {
+    for (; (size_t)(end - p) >= len; p++) {
+        size_t i = 0;
+        while (i < len && tolower(p[i]) == (unsigned char)needle[i]) i++;
+        if (i == len) return p;
+    }
+    return NULL;
+}
+
+/* Extract a line containing the search term from file. The file is
+   scanned in place through a (cached) mapping; only the line that
+   matched is copied, into out. */
  int extract_matching_line(const char *filename,
                                  const char *query,
                                  char *out, int out_size) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
+    Span span;
+    if (span_open_file(filename, &span) != 0) {
         snprintf(out, out_size, "(Could not open file)");
         return -1;
     }
 
-    char line[1024];
     int line_no = 1;
     char query_lower[256];
 
@@ -329,26 +576,25 @@ void get_search_stats(int *t_docs, int *t_q, double *avg) {
     query_lower[sizeof(query_lower)-1] = '\0';
     for (int i = 0; query_lower[i]; i++)
         query_lower[i] = tolower(query_lower[i]);
+    size_t query_len = strlen(query_lower);
 
-    while (fgets(line, sizeof(line), fp)) {
-        char line_lower[1024];
-        strncpy(line_lower, line, sizeof(line_lower));
-        line_lower[sizeof(line_lower)-1] = '\0';
-
-        for (int i = 0; line_lower[i]; i++)
-            line_lower[i] = tolower(line_lower[i]);
+    const unsigned char *p = span.data, *end = span.data + span.size;
+    while (p < end) {
+        const unsigned char *nl = memchr(p, '\n', (size_t)(end - p));
+        const unsigned char *eol = nl ? nl + 1 : end;
 
-        if (strstr(line_lower, query_lower)) {
+        if (find_nocase(p, eol, query_lower, query_len)) {
             snprintf(out, out_size,
-                     "Line %d: %s", line_no, line);
-            fclose(fp);
+                     "Line %d: %.*s", line_no, (int)(eol - p), (const char *)p);
+            span_close(&span);
             return line_no;
         }
 
         line_no++;
+        p = eol;
     }
 
-    fclose(fp);
+    span_close(&span);
     snprintf(out, out_size, "(No matching line found)");
     return -1;
 }
@@ -55,6 +55,8 @@ typedef struct {
 
 /* Core functions */
 void add_document_to_search_engine(const char *filename);
+/* Files added together; returns how many were taken */
+int add_documents_to_search_engine(const char *const *filenames, int count);
 void add_document_to_search_engine_virtual(const search_result_t *doc);
 
 int init_search_engine(void);
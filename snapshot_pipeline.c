@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "snapshot_pipeline.h"
+#include "worker_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define BINARY_PROBE 8000             // NUL in the first bytes: binary file
+
+/* =============== TOKENIZER =================== */
+
+/* Words are runs of [A-Za-z0-9_], lowercased; state survives chunk edges */
+typedef struct Tokenizer {
+    char word[WORD_MAX_LEN + 1];
+    int len;
+    ByteBuf *out;
+} Tokenizer;
+
+static void tokenizer_flush(Tokenizer *t) {
+    if (t->len == 0) return;
+    buf_put(t->out, t->word, (size_t)t->len);
+    buf_put(t->out, "", 1);
+    t->len = 0;
+}
+
+static void tokenizer_feed(Tokenizer *t, const unsigned char *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = p[i];
+        if (isalnum(c) || c == '_') {
+            if (t->len < WORD_MAX_LEN)
+                t->word[t->len++] = (char)tolower(c);
+        } else {
+            tokenizer_flush(t);
+        }
+    }
+}
+
+/* =============== ONE JOB =================== */
+
+static void run_job(SnapshotJob *job) {
+    FILE *fp = fopen(job->path, "rb");
+    if (!fp) {
+        job->failed = 1;
+        return;
+    }
+
+    if (job->store && object_writer_open(&job->writer) != 0) {
+        fclose(fp);
+        job->failed = 1;
+        return;
+    }
+
+    Tokenizer tok = { .len = 0, .out = &job->words };
+    int tokenize = job->tokenize;
+    int first = 1;
+
+    unsigned char *chunk = malloc(OBJECT_CHUNK_SIZE);
+    size_t n = 0;
+    if (!chunk) job->failed = 1;
+
+    while (chunk && (n = fread(chunk, 1, OBJECT_CHUNK_SIZE, fp)) > 0) {
+        if (job->store && object_writer_write(&job->writer, chunk, n) != 0) {
+            job->failed = 1;
+            break;
+        }
+        if (first) {
+            first = 0;
+            if (memchr(chunk, '\0', n < BINARY_PROBE ? n : BINARY_PROBE))
+                tokenize = 0;
+        }
+        if (tokenize) tokenizer_feed(&tok, chunk, n);
+        else if (!job->store) break;              // nothing left to do
+    }
+    if (ferror(fp)) job->failed = 1;
+    fclose(fp);
+    free(chunk);
+
+    if (tokenize) tokenizer_flush(&tok);
+    if (job->words.failed) job->failed = 1;
+    if (!job->failed && job->store && object_writer_flush(&job->writer) != 0) job->failed = 1;
+    if (job->failed && job->store) object_writer_abort(&job->writer);
+}
+
+/* =============== PIPELINE =================== */
+
+static void run_job_at(void *ctx, int i) {
+    run_job(&((SnapshotJob *)ctx)[i]);
+}
+
+int snapshot_pipeline_run(SnapshotJob *jobs, int count) {
+    return parallel_for(count, run_job_at, jobs);
+}
+
+void snapshot_job_free(SnapshotJob *job) {
+    buf_free(&job->words);
+}
+
+int snapshot_tokenize_file(const char *path, ByteBuf *words) {
+    SnapshotJob job;
+    memset(&job, 0, sizeof(job));
+    job.path = path;
+    job.tokenize = 1;
+
+    run_job(&job);
+    *words = job.words;
+    return job.failed ? -1 : 0;
+}
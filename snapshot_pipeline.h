@@ -0,0 +1,32 @@
+#ifndef SNAPSHOT_PIPELINE_H
+#define SNAPSHOT_PIPELINE_H
+
+#include "object_store.h"
+#include "bytebuf.h"
+
+#define WORD_MAX_LEN 255      // longer tokens are truncated
+
+/* -------- One file to snapshot on a worker thread -------- */
+/* Workers read the file once in OBJECT_CHUNK_SIZE pieces, hashing and
+   writing it to a temp object and tokenizing it into the job's own word
+   fragment. Nothing shared is touched: the caller installs the object
+   (object_writer_finish) and merges the fragments on its own thread. */
+typedef struct SnapshotJob {
+    const char *path;
+    int store;                    // hash + write a temp object
+    int tokenize;                 // collect words for the search index
+
+    /* results, valid after snapshot_pipeline_run() */
+    ObjectWriter writer;          // open until the caller finishes it
+    ByteBuf words;                // NUL-separated lowercase words
+    int failed;
+} SnapshotJob;
+
+/* Process all jobs; returns the number of worker threads used */
+int  snapshot_pipeline_run(SnapshotJob *jobs, int count);
+void snapshot_job_free(SnapshotJob *job);
+
+/* Tokenize a file on the calling thread (same rules as the workers) */
+int  snapshot_tokenize_file(const char *path, ByteBuf *words);
+
+#endif /* SNAPSHOT_PIPELINE_H */
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE            // st_mtimespec
+#endif
+
+#include "span.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // stat, fstat
+
+#ifdef __APPLE__
+#define STAT_MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#endif
+
+typedef struct SpanEntry {
+    char *path;                   // NULL: free slot
+    dev_t dev;
+    ino_t ino;
+    size_t size;
+    time_t mtime_sec;
+    long mtime_nsec;
+    void *map;                    // NULL for an empty file
+    int refs;                     // spans currently open on it
+    int stale;                    // file changed while held: drop on last close
+    unsigned long last_use;
+} SpanEntry;
+
+static SpanEntry cache[SPAN_CACHE_SLOTS];
+static unsigned long use_clock = 0;
+
+static const unsigned char empty[1] = "";
+
+static int same_file(const SpanEntry *e, const struct stat *st) {
+    return e->dev == st->st_dev && e->ino == st->st_ino &&
+           e->size == (size_t)st->st_size && e->mtime_sec == st->st_mtime &&
+           e->mtime_nsec == (long)STAT_MTIME_NSEC(st);
+}
+
+static void drop_entry(SpanEntry *e) {
+    if (e->map) munmap(e->map, e->size);
+    free(e->path);
+    memset(e, 0, sizeof(*e));
+}
+
+/* Free slot, else the least recently used one nobody holds; -1 if none */
+static int pick_slot(void) {
+    int victim = -1;
+    for (int i = 0; i < SPAN_CACHE_SLOTS; i++) {
+        const SpanEntry *e = &cache[i];
+        if (!e->path) return i;
+        if (e->refs == 0 && (victim < 0 || e->last_use < cache[victim].last_use))
+            victim = i;
+    }
+    return victim;
+}
+
+static int map_path(const char *path, struct stat *st, void **map) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    *map = NULL;
+    int rc = fstat(fd, st) == 0 && S_ISREG(st->st_mode) ? 0 : -1;
+    if (rc == 0 && st->st_size > 0) {
+        *map = mmap(NULL, (size_t)st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*map == MAP_FAILED) {
+            *map = NULL;
+            rc = -1;
+        }
+    }
+    close(fd);
+    return rc;
+}
+
+int span_open_file(const char *path, Span *out) {
+    memset(out, 0, sizeof(*out));
+    out->slot = -1;
+
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+
+    for (int i = 0; i < SPAN_CACHE_SLOTS; i++) {
+        SpanEntry *e = &cache[i];
+        if (!e->path || e->stale || strcmp(e->path, path) != 0) continue;
+
+        if (same_file(e, &st)) {
+            e->refs++;
+            e->last_use = ++use_clock;
+            out->data = e->map ? e->map : empty;
+            out->size = e->size;
+            out->slot = i;
+            return 0;
+        }
+        if (e->refs == 0) drop_entry(e);
+        else e->stale = 1;
+    }
+
+    void *map;
+    if (map_path(path, &st, &map) != 0) return -1;
+    out->data = map ? map : empty;
+    out->size = (size_t)st.st_size;
+
+    int slot = pick_slot();
+    char *copy = slot >= 0 ? strdup(path) : NULL;
+    if (!copy) {
+        out->own_map = map;                       // held only by this span
+        return 0;
+    }
+
+    SpanEntry *e = &cache[slot];
+    if (e->path) drop_entry(e);
+    e->path = copy;
+    e->dev = st.st_dev;
+    e->ino = st.st_ino;
+    e->size = (size_t)st.st_size;
+    e->mtime_sec = st.st_mtime;
+    e->mtime_nsec = (long)STAT_MTIME_NSEC(&st);
+    e->map = map;
+    e->refs = 1;
+    e->last_use = ++use_clock;
+    out->slot = slot;
+    return 0;
+}
+
+int span_open_blob(Blob *blob, Span *out) {
+    memset(out, 0, sizeof(*out));
+    out->slot = -1;
+
+    const unsigned char *data = blob_view(blob);
+    if (!data) return -1;
+    out->data = data;
+    out->size = blob->size;
+    return 0;
+}
+
+void span_close(Span *s) {
+    if (s->slot >= 0) {
+        SpanEntry *e = &cache[s->slot];
+        if (--e->refs == 0 && e->stale) drop_entry(e);
+    }
+    if (s->own_map) munmap(s->own_map, s->size);
+    memset(s, 0, sizeof(*s));
+    s->slot = -1;
+}
+
+void span_cache_clear(void) {
+    for (int i = 0; i < SPAN_CACHE_SLOTS; i++)
+        if (cache[i].path && cache[i].refs == 0) drop_entry(&cache[i]);
+}
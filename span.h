@@ -0,0 +1,32 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stddef.h>
+
+#include "object_store.h"
+
+/* -------- Read-only spans over file and blob content -------- */
+/* A Span borrows the bytes of a file or blob without copying them.
+   Files are mapped and the mappings kept in a small cache keyed by
+   path; each open re-checks the file's identity (device, inode, size,
+   mtime) with one stat, so a file viewed or searched again is neither
+   re-read nor re-copied, and a changed file is mapped afresh. Blobs are
+   served by blob_view(). Spans are not NUL-terminated and belong to the
+   main thread. */
+typedef struct Span {
+    const unsigned char *data;
+    size_t size;
+    int slot;                     // cache entry held open, -1 if none
+    void *own_map;                // mapping outside the cache (all slots busy)
+} Span;
+
+#define SPAN_CACHE_SLOTS 16
+
+int  span_open_file(const char *path, Span *out);   // 0 on success
+int  span_open_blob(Blob *blob, Span *out);         // 0 on success
+void span_close(Span *s);
+
+/* Unmap every cached file that no span holds open */
+void span_cache_clear(void);
+
+#endif /* SPAN_H */
@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE            // st_mtimespec
+#endif
+
+#include "staging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>     // getcwd
+
+#ifdef __APPLE__
+#define STAT_MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#endif
+
+#define INITIAL_SLOTS 64
+
+/* =============== PATHS =================== */
+
+int staging_normalize(const char *path, char *out, size_t out_size) {
+    char buf[2 * STAGING_PATH_MAX];
+    int n;
+    if (path[0] == '/') {
+        n = snprintf(buf, sizeof(buf), "%s", path);
+    } else {
+        char cwd[STAGING_PATH_MAX];
+        if (!getcwd(cwd, sizeof(cwd))) return -1;
+        n = snprintf(buf, sizeof(buf), "%s/%s", cwd, path);
+    }
+    if (n < 0 || (size_t)n >= sizeof(buf) || out_size < 2) return -1;
+
+    /* Rebuild as "/seg/seg...", folding "." and ".." as we go */
+    size_t w = 0;
+    const char *p = buf;
+    while (*p) {
+        while (*p == '/') p++;
+        const char *seg = p;
+        while (*p && *p != '/') p++;
+        size_t len = (size_t)(p - seg);
+
+        if (len == 0 || (len == 1 && seg[0] == '.')) continue;
+        if (len == 2 && seg[0] == '.' && seg[1] == '.') {
+            while (w > 0 && out[--w] != '/')
+                ;
+            continue;
+        }
+        if (w + 1 + len + 1 > out_size) return -1;
+        out[w++] = '/';
+        memcpy(out + w, seg, len);
+        w += len;
+    }
+    if (w == 0) out[w++] = '/';
+    out[w] = '\0';
+    return 0;
+}
+
+static uint64_t path_hash(const char *path) {
+    uint64_t h = 1469598103934665603ull;          // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/* =============== HASH SET =================== */
+
+/* Slot holding path, or the empty slot where it would go */
+static size_t probe(const StagingArea *s, const char *path, uint64_t hash) {
+    size_t mask = s->slot_count - 1;
+    size_t i = (size_t)hash & mask;
+    while (s->slots[i]) {
+        const StagedFile *f = &s->entries[s->slots[i] - 1];
+        if (f->hash == hash && strcmp(f->path, path) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static int grow_slots(StagingArea *s) {
+    size_t count = s->slot_count ? s->slot_count * 2 : INITIAL_SLOTS;
+    int32_t *slots = calloc(count, sizeof(int32_t));
+    if (!slots) return -1;
+
+    free(s->slots);
+    s->slots = slots;
+    s->slot_count = count;
+    for (int i = 0; i < s->count; i++)
+        s->slots[probe(s, s->entries[i].path, s->entries[i].hash)] = i + 1;
+    return 0;
+}
+
+StagedFile *staging_find(const StagingArea *s, const char *path) {
+    if (!s->slot_count) return NULL;
+    int32_t slot = s->slots[probe(s, path, path_hash(path))];
+    return slot ? &s->entries[slot - 1] : NULL;
+}
+
+StagedFile *staging_insert(StagingArea *s, const char *path, int *added) {
+    *added = 0;
+    if ((size_t)(s->count + 1) * 4 > s->slot_count * 3 && grow_slots(s) != 0)
+        return NULL;
+
+    uint64_t hash = path_hash(path);
+    size_t i = probe(s, path, hash);
+    if (s->slots[i]) return &s->entries[s->slots[i] - 1];
+
+    if (s->count == s->cap) {
+        int cap = s->cap ? s->cap * 2 : 16;
+        StagedFile *p = realloc(s->entries, (size_t)cap * sizeof(StagedFile));
+        if (!p) return NULL;
+        s->entries = p;
+        s->cap = cap;
+    }
+
+    StagedFile *f = &s->entries[s->count];
+    memset(f, 0, sizeof(*f));
+    f->path = strdup(path);
+    if (!f->path) return NULL;
+    f->hash = hash;
+
+    s->slots[i] = ++s->count;
+    *added = 1;
+    return f;
+}
+
+int staging_unchanged(const StagedFile *f, const struct stat *st) {
+    return f->blob && f->st.st_dev == st->st_dev && f->st.st_ino == st->st_ino &&
+           f->st.st_size == st->st_size && f->st.st_mtime == st->st_mtime &&
+           STAT_MTIME_NSEC(&f->st) == STAT_MTIME_NSEC(st);
+}
+
+void staging_clear(StagingArea *s) {
+    for (int i = 0; i < s->count; i++) {
+        free(s->entries[i].path);
+        free(s->entries[i].name);
+        blob_release(s->entries[i].blob);
+    }
+    free(s->entries);
+    free(s->slots);
+    memset(s, 0, sizeof(*s));
+}
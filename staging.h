@@ -0,0 +1,52 @@
+#ifndef STAGING_H
+#define STAGING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "object_store.h"
+
+#define STAGING_PATH_MAX 512
+
+/* -------- Staging area: the set of files added for the next commit -------- */
+/* Keyed by normalized path (absolute, "." / ".." / repeated slashes
+   folded), so "a.c", "./a.c" and "/cwd/a.c" are one entry and adding a
+   file twice stages it once. Open addressing over a table of entry
+   indices; entries stay in the order they were first added. Each entry
+   keeps the name it will be committed under, and the stat data and
+   blob (content id) taken when it was added, trusted at commit time
+   while the file is unchanged. */
+typedef struct StagedFile {
+    char *path;                   // normalized (owned)
+    uint64_t hash;                // of path
+    char *name;                   // name in the commit (owned)
+    struct stat st;               // when it was added
+    Blob *blob;                   // its content then; one reference held
+    int is_new;                   // the add stored the blob for the first time
+} StagedFile;
+
+typedef struct StagingArea {
+    StagedFile *entries;          // insertion order
+    int count;
+    int cap;
+    int32_t *slots;               // entry index + 1, 0 if empty
+    size_t slot_count;            // power of two
+} StagingArea;
+
+/* Normalize path against the current directory. 0 on success, -1 if
+   it does not fit in out_size. */
+int  staging_normalize(const char *path, char *out, size_t out_size);
+
+StagedFile *staging_find(const StagingArea *s, const char *path);
+
+/* The entry for a normalized path, created (with no name or blob) if
+   missing; *added is set to 1 if it was. NULL if memory ran out. */
+StagedFile *staging_insert(StagingArea *s, const char *path, int *added);
+
+/* Same file, same size and mtime as when it was added */
+int  staging_unchanged(const StagedFile *f, const struct stat *st);
+
+void staging_clear(StagingArea *s);   // releases the staged blobs
+
+#endif /* STAGING_H */
@@ -0,0 +1,45 @@
+#!/bin/sh
+# save, save, delete, gc, restart: the surviving commit must load with
+# its content, whether the GC cycle ran in the background or by `gc`.
+# Usage: tests/gc_restart.sh [path/to/minigitsearch]
+
+BIN=$(cd "$(dirname "${1:-./minigitsearch}")" && pwd)/$(basename "${1:-./minigitsearch}")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+fail=0
+
+run_case() {
+    name=$1
+    gc_cmd=$2
+    dir="$TMP/$name"
+    mkdir -p "$dir/.mgit_work"
+    cd "$dir" || exit 1
+
+    echo one > .mgit_work/a.txt
+    echo kept > .mgit_work/b.txt
+    {
+        printf 'save one\n'
+        sleep 0.2
+        echo two > .mgit_work/a.txt
+        printf 'save two\ndelete 1\n%bexit\n' "$gc_cmd"
+    } | "$BIN" > session.log 2>&1
+
+    rm -rf .mgit_work
+    printf 'log\ncheckout 2\nexit\n' | "$BIN" > restart.log 2>&1
+
+    if ! grep -q 'Commit 2 \[' restart.log || grep -q 'No commits yet' restart.log; then
+        echo "FAIL ($name): commit 2 lost after restart"
+        fail=1
+    elif [ "$(cat .mgit_work/a.txt 2>/dev/null)" != two ] ||
+         [ "$(cat .mgit_work/b.txt 2>/dev/null)" != kept ]; then
+        echo "FAIL ($name): commit 2 checked out wrong content"
+        fail=1
+    else
+        echo "ok ($name)"
+    fi
+}
+
+run_case background ''
+run_case explicit 'gc\n'
+
+exit $fail
@@ -0,0 +1,60 @@
+#include "topk.h"
+
+/* a ranks below b */
+static int worse(const ScoredDoc *a, const ScoredDoc *b) {
+    if (a->score != b->score) return a->score < b->score;
+    return a->doc > b->doc;
+}
+
+static void sift_down(ScoredDoc *h, int n, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && worse(&h[l], &h[m])) m = l;
+        if (r < n && worse(&h[r], &h[m])) m = r;
+        if (m == i) return;
+        ScoredDoc tmp = h[i];
+        h[i] = h[m];
+        h[m] = tmp;
+        i = m;
+    }
+}
+
+void topk_init(TopK *t, ScoredDoc *storage, int k) {
+    t->items = storage;
+    t->count = 0;
+    t->k = k > 0 ? k : 0;
+}
+
+int topk_push(TopK *t, float score, uint32_t doc) {
+    ScoredDoc d = { score, doc };
+    if (t->count < t->k) {
+        int i = t->count++;
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (!worse(&d, &t->items[parent])) break;
+            t->items[i] = t->items[parent];
+            i = parent;
+        }
+        t->items[i] = d;
+        return 1;
+    }
+    if (t->k == 0 || !worse(&t->items[0], &d)) return 0;
+    t->items[0] = d;
+    sift_down(t->items, t->count, 0);
+    return 1;
+}
+
+float topk_threshold(const TopK *t) {
+    return t->count < t->k || t->k == 0 ? -1.0f : t->items[0].score;
+}
+
+int topk_finish(TopK *t) {
+    /* Heap sort: popping the worst to the back leaves the best first */
+    for (int n = t->count - 1; n > 0; n--) {
+        ScoredDoc tmp = t->items[0];
+        t->items[0] = t->items[n];
+        t->items[n] = tmp;
+        sift_down(t->items, n, 0);
+    }
+    return t->count;
+}
@@ -0,0 +1,35 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stdint.h>
+
+/* -------- The k best (score, doc) pairs of a stream -------- */
+/* A bounded min-heap: the worst pair kept sits at the root, so a new
+   pair is compared with it once and, if better, replaces it in
+   O(log k). Higher scores are better; equal scores prefer the lower
+   doc. The caller provides room for k pairs. */
+typedef struct ScoredDoc {
+    float score;
+    uint32_t doc;
+} ScoredDoc;
+
+typedef struct TopK {
+    ScoredDoc *items;
+    int count;
+    int k;
+} TopK;
+
+void topk_init(TopK *t, ScoredDoc *storage, int k);
+
+/* 1 if the pair was kept */
+int  topk_push(TopK *t, float score, uint32_t doc);
+
+/* Score a pair must beat to be kept: the worst kept once k are held,
+   -1 before that (scores are not negative) */
+float topk_threshold(const TopK *t);
+
+/* Sort the kept pairs best first, in place; returns how many there
+   are. The heap is used up. */
+int  topk_finish(TopK *t);
+
+#endif /* TOPK_H */
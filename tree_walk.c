@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE             // d_type
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE
+#endif
+
+#include "tree_walk.h"
+#include "worker_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>     // opendir, readdir
+#include <sys/stat.h>   // stat, lstat
+
+/* =============== NAME LISTS =================== */
+
+typedef struct NameList {
+    char **items;
+    int count;
+    int cap;
+} NameList;
+
+static int name_list_reserve(NameList *l, int extra) {
+    if (l->count + extra <= l->cap) return 0;
+    int cap = l->cap ? l->cap : 16;
+    while (cap < l->count + extra) cap *= 2;
+    char **p = realloc(l->items, (size_t)cap * sizeof(char *));
+    if (!p) return -1;
+    l->items = p;
+    l->cap = cap;
+    return 0;
+}
+
+static int name_list_push(NameList *l, const char *name, size_t len) {
+    if (name_list_reserve(l, 1) != 0) return -1;
+    char *copy = malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    l->items[l->count++] = copy;
+    return 0;
+}
+
+/* Move every name of src to the end of dst */
+static int name_list_take(NameList *dst, NameList *src) {
+    if (src->count == 0) return 0;
+    if (name_list_reserve(dst, src->count) != 0) return -1;
+    memcpy(dst->items + dst->count, src->items, (size_t)src->count * sizeof(char *));
+    dst->count += src->count;
+    src->count = 0;
+    return 0;
+}
+
+static void name_list_free(NameList *l) {
+    for (int i = 0; i < l->count; i++) free(l->items[i]);
+    free(l->items);
+    memset(l, 0, sizeof(*l));
+}
+
+static int cmp_name(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* =============== ONE LEVEL =================== */
+
+/* What listing one directory turned up */
+typedef struct DirScan {
+    NameList files;
+    NameList dirs;
+    int ignored;
+    int errors;
+    int oom;
+} DirScan;
+
+typedef struct WalkLevel {
+    const char *root;
+    char **dirs;                  // relative to root, "" for root itself
+    DirScan *scans;               // one per dir
+    WalkIgnoreFn ignore;
+    void *ctx;
+} WalkLevel;
+
+/* 1 for a file, 2 for a directory, 0 for anything else */
+static int entry_kind(const struct dirent *dp, const char *path) {
+#ifdef DT_DIR
+    if (dp->d_type == DT_REG) return 1;
+    if (dp->d_type == DT_DIR) return 2;
+    if (dp->d_type != DT_LNK && dp->d_type != DT_UNKNOWN) return 0;
+#else
+    (void)dp;
+#endif
+    struct stat st;
+    if (lstat(path, &st) != 0) return 0;
+    if (S_ISLNK(st.st_mode))
+        return stat(path, &st) == 0 && S_ISREG(st.st_mode) ? 1 : 0;
+    return S_ISREG(st.st_mode) ? 1 : S_ISDIR(st.st_mode) ? 2 : 0;
+}
+
+static void scan_dir(void *arg, int i) {
+    WalkLevel *lv = (WalkLevel *)arg;
+    DirScan *scan = &lv->scans[i];
+    const char *rel = lv->dirs[i];
+
+    char dir_path[WALK_PATH_MAX];
+    int n = rel[0] ? snprintf(dir_path, sizeof(dir_path), "%s/%s", lv->root, rel)
+                   : snprintf(dir_path, sizeof(dir_path), "%s", lv->root);
+    DIR *dir = (n > 0 && (size_t)n < sizeof(dir_path)) ? opendir(dir_path) : NULL;
+    if (!dir) {
+        scan->errors++;
+        return;
+    }
+
+    struct dirent *dp;
+    while ((dp = readdir(dir))) {
+        if (dp->d_name[0] == '.') continue;
+
+        char path[WALK_PATH_MAX], child[WALK_PATH_MAX];
+        int pn = snprintf(path, sizeof(path), "%s/%s", dir_path, dp->d_name);
+        int cn = rel[0] ? snprintf(child, sizeof(child), "%s/%s", rel, dp->d_name)
+                        : snprintf(child, sizeof(child), "%s", dp->d_name);
+        if (pn < 0 || (size_t)pn >= sizeof(path) || cn < 0 || (size_t)cn >= sizeof(child)) {
+            scan->errors++;
+            continue;
+        }
+
+        int kind = entry_kind(dp, path);
+        if (!kind) continue;
+        if (lv->ignore && lv->ignore(lv->ctx, child, kind == 2)) {
+            scan->ignored++;
+            continue;
+        }
+        if (name_list_push(kind == 2 ? &scan->dirs : &scan->files, child, (size_t)cn) != 0) {
+            scan->oom = 1;
+            break;
+        }
+    }
+    closedir(dir);
+}
+
+/* =============== WALK =================== */
+
+int tree_walk(const char *root, WalkIgnoreFn ignore, void *ctx, WalkResult *out) {
+    memset(out, 0, sizeof(*out));
+
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) return -1;
+
+    NameList level = {0}, files = {0};
+    int rc = name_list_push(&level, "", 0);
+
+    while (rc == 0 && level.count) {
+        DirScan *scans = calloc((size_t)level.count, sizeof(DirScan));
+        if (!scans) {
+            rc = -1;
+            break;
+        }
+        WalkLevel lv = { root, level.items, scans, ignore, ctx };
+        parallel_for(level.count, scan_dir, &lv);
+        out->dirs += level.count;
+
+        /* Gather in directory order, so the result does not depend on
+           which worker finished first */
+        NameList next = {0};
+        for (int i = 0; i < level.count; i++) {
+            DirScan *s = &scans[i];
+            out->ignored += s->ignored;
+            out->errors += s->errors;
+            if (s->oom || name_list_take(&files, &s->files) != 0 ||
+                name_list_take(&next, &s->dirs) != 0)
+                rc = -1;
+            name_list_free(&s->files);
+            name_list_free(&s->dirs);
+        }
+        free(scans);
+        name_list_free(&level);
+        level = next;
+    }
+    name_list_free(&level);
+
+    if (rc != 0) {
+        name_list_free(&files);
+        memset(out, 0, sizeof(*out));
+        return -1;
+    }
+    if (files.count)
+        qsort(files.items, (size_t)files.count, sizeof(char *), cmp_name);
+    out->files = files.items;
+    out->count = files.count;
+    return 0;
+}
+
+void walk_result_free(WalkResult *r) {
+    for (int i = 0; i < r->count; i++) free(r->files[i]);
+    free(r->files);
+    memset(r, 0, sizeof(*r));
+}
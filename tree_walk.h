@@ -0,0 +1,29 @@
+#ifndef TREE_WALK_H
+#define TREE_WALK_H
+
+#define WALK_PATH_MAX 1024
+
+/* -------- Parallel walk of a directory tree -------- */
+/* The tree is read one depth at a time: every directory of a level is
+   listed on the worker pool, and the subdirectories found make up the
+   next level. Dot entries (.mgit, .mgit_work, .git, ...) are never
+   entered. Symlinks to files count as files; symlinked directories are
+   not followed. The ignore hook is asked about each entry before it is
+   kept or entered, from worker threads, so it must only read shared
+   state; a directory it rejects is pruned with everything below it. */
+typedef int (*WalkIgnoreFn)(void *ctx, const char *rel_path, int is_dir);
+
+typedef struct WalkResult {
+    char **files;                 // paths relative to root, sorted (owned)
+    int count;
+    int dirs;                     // directories listed, root included
+    int ignored;                  // entries the ignore hook rejected
+    int errors;                   // unreadable directories, overlong paths
+} WalkResult;
+
+/* Walk root; ignore may be NULL. 0 on success, -1 if root cannot be
+   opened or memory ran out (out is then empty). */
+int  tree_walk(const char *root, WalkIgnoreFn ignore, void *ctx, WalkResult *out);
+void walk_result_free(WalkResult *r);
+
+#endif /* TREE_WALK_H */
@@ -43,6 +43,14 @@ void trie_insert_word(const char* word, const char* filename) {
         if (strcmp(current->files[i].filename, filename) == 0) return;
     }
     if (current->file_count < MAX_FILES_PER_WORD) {
+        if (current->file_count == current->file_cap) {
+            int cap = current->file_cap ? current->file_cap * 2 : 2;
+            if (cap > MAX_FILES_PER_WORD) cap = MAX_FILES_PER_WORD;
+            FileNode* files = (FileNode*)realloc(current->files, cap * sizeof(FileNode));
+            if (!files) return;
+            current->files = files;
+            current->file_cap = cap;
+        }
         strncpy(current->files[current->file_count].filename, filename, MAX_FILENAME_LENGTH - 1);
         current->files[current->file_count].filename[MAX_FILENAME_LENGTH - 1] = '\0';
         current->file_count++;
@@ -83,6 +91,7 @@ static void free_trie_node(TrieNode* node) {
     for (int i = 0; i < ALPHABET_SIZE; i++) {
         free_trie_node(node->children[i]);
     }
+    free(node->files);
     free(node);
 }
 
@@ -14,8 +14,9 @@ typedef struct FileNode {
 typedef struct TrieNode {
     struct TrieNode* children[ALPHABET_SIZE];
     bool is_word_end;
-    FileNode files[MAX_FILES_PER_WORD];
+    FileNode* files;        // word ends only, grown up to MAX_FILES_PER_WORD
     int file_count;
+    int file_cap;
 } TrieNode;
 
 void trie_insert_word(const char* word, const char* filename);
@@ -0,0 +1,208 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "wal.h"
+#include "bytebuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // write, fsync, ftruncate, close
+#include <sys/mman.h>   // mmap, munmap
+#include <sys/stat.h>   // fstat
+
+#define WAL_MAGIC        "MGITWAL"
+#define WAL_VERSION      1
+#define WAL_HEADER_SIZE  8
+#define RECORD_HEADER    9              // type(1) len(4) crc(4)
+
+static int    wal_fd = -1;
+static size_t wal_len = 0;              // bytes known to be intact
+static int    pending = 0;              // records written but not fsynced
+static long long pending_since_ms = 0;
+
+/* =============== CRC-32 =================== */
+
+static uint32_t crc_table[256];
+
+static uint32_t crc32_of(int type, const unsigned char *p, size_t len) {
+    if (!crc_table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc_table[i] = c;
+        }
+    }
+
+    /* The type byte is covered too, so a flipped type is caught */
+    uint32_t c = 0xFFFFFFFFu;
+    c = crc_table[(c ^ (unsigned char)type) & 0xff] ^ (c >> 8);
+    for (size_t i = 0; i < len; i++)
+        c = crc_table[(c ^ p[i]) & 0xff] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int write_all(int fd, const unsigned char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* =============== OPEN / CLOSE =================== */
+
+int wal_open(const char *path) {
+    wal_close();
+
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        unsigned char header[WAL_HEADER_SIZE];
+        memcpy(header, WAL_MAGIC, 7);
+        header[7] = WAL_VERSION;
+        if (write_all(fd, header, sizeof(header)) != 0 || fsync(fd) != 0) {
+            close(fd);
+            return -1;
+        }
+        st.st_size = WAL_HEADER_SIZE;
+    } else {
+        unsigned char header[WAL_HEADER_SIZE];
+        if (st.st_size < WAL_HEADER_SIZE ||
+            pread(fd, header, sizeof(header), 0) != WAL_HEADER_SIZE ||
+            memcmp(header, WAL_MAGIC, 7) != 0 || header[7] != WAL_VERSION) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    wal_fd = fd;
+    wal_len = (size_t)st.st_size;
+    pending = 0;
+    return 0;
+}
+
+void wal_close(void) {
+    if (wal_fd < 0) return;
+    wal_sync();
+    close(wal_fd);
+    wal_fd = -1;
+    wal_len = 0;
+}
+
+/* =============== APPEND / SYNC =================== */
+
+int wal_append(int type, const void *payload, size_t len) {
+    if (wal_fd < 0 || len > UINT32_MAX) return -1;
+
+    ByteBuf b = {0};
+    buf_put_uint(&b, (uint64_t)type, 1);
+    buf_put_uint(&b, len, 4);
+    buf_put_uint(&b, crc32_of(type, payload, len), 4);
+    buf_put(&b, payload, len);
+
+    int rc = b.failed ? -1 : write_all(wal_fd, b.data, b.len);
+    if (rc == 0) {
+        wal_len += b.len;
+        if (pending++ == 0) pending_since_ms = now_ms();
+    } else {
+        /* Drop the partial record; if even that fails, replay cuts it
+           off at the bad CRC */
+        int ignored = ftruncate(wal_fd, (off_t)wal_len);
+        (void)ignored;
+    }
+    buf_free(&b);
+    return rc;
+}
+
+int wal_sync_due(void) {
+    if (pending == 0) return 0;
+    return pending >= WAL_GROUP_RECORDS ||
+           now_ms() - pending_since_ms >= WAL_GROUP_WINDOW_MS;
+}
+
+int wal_sync_wait_ms(void) {
+    if (pending == 0) return -1;
+    if (wal_sync_due()) return 0;
+    return (int)(WAL_GROUP_WINDOW_MS - (now_ms() - pending_since_ms));
+}
+
+int wal_sync(void) {
+    if (wal_fd < 0 || pending == 0) return 0;
+    if (fsync(wal_fd) != 0) return -1;
+    pending = 0;
+    return 0;
+}
+
+size_t wal_size(void) {
+    return wal_len;
+}
+
+/* =============== REPLAY =================== */
+
+int wal_replay(WalReplayFn fn, void *ctx) {
+    if (wal_fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(wal_fd, &st) != 0) return -1;
+    size_t len = (size_t)st.st_size;
+    if (len <= WAL_HEADER_SIZE) return 0;
+
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, wal_fd, 0);
+    if (map == MAP_FAILED) return -1;
+
+    Reader rd = { (const unsigned char *)map + WAL_HEADER_SIZE,
+                  (const unsigned char *)map + len, 1 };
+    size_t good = WAL_HEADER_SIZE;
+    int replayed = 0;
+
+    while (rd.p < rd.end) {
+        int type = (int)rd_uint(&rd, 1);
+        size_t plen = (size_t)rd_uint(&rd, 4);
+        uint32_t crc = (uint32_t)rd_uint(&rd, 4);
+        const unsigned char *payload = rd_bytes(&rd, plen);
+        if (!rd.ok || crc32_of(type, payload, plen) != crc) break;
+
+        if (fn(type, payload, plen, ctx) != 0) break;
+        good += RECORD_HEADER + plen;
+        replayed++;
+    }
+    munmap(map, len);
+
+    /* Torn tail from a crash mid-append: drop it so new records follow
+       an intact one */
+    if (good < len) {
+        if (ftruncate(wal_fd, (off_t)good) != 0 || fsync(wal_fd) != 0)
+            return -1;
+    }
+    wal_len = good;
+    return replayed;
+}
+
+int wal_reset(void) {
+    if (wal_fd < 0) return -1;
+    if (ftruncate(wal_fd, WAL_HEADER_SIZE) != 0 || fsync(wal_fd) != 0)
+        return -1;
+    wal_len = WAL_HEADER_SIZE;
+    pending = 0;
+    return 0;
+}
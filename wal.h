@@ -0,0 +1,40 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+
+/* Append-only write-ahead log.
+ *
+ *   header  "MGITWAL" version(1)
+ *   record  type(1) len(4) crc32(4) payload(len)
+ *
+ * Records reach the file with write() before the caller reports success,
+ * so a crashed process never loses one. fsync is batched (group commit):
+ * the log is synced once WAL_GROUP_RECORDS records are pending or the
+ * oldest pending one is WAL_GROUP_WINDOW_MS old, and on wal_sync().
+ * The window is checked on append and, so that a last record is not
+ * left waiting while the program idles, by the caller's event loop
+ * (wal_sync_wait_ms).
+ * A torn or corrupt tail is cut off at the last intact record on replay.
+ */
+#define WAL_GROUP_RECORDS    8
+#define WAL_GROUP_WINDOW_MS  100
+
+int    wal_open(const char *path);           // create if missing; 0 on success
+void   wal_close(void);
+
+int    wal_append(int type, const void *payload, size_t len);
+int    wal_sync_due(void);                   // group full or window expired
+int    wal_sync_wait_ms(void);               // ms until due (0: now), -1 if none pending
+int    wal_sync(void);
+size_t wal_size(void);
+
+/* Call fn for each intact record in order, then truncate any torn tail.
+   fn returns 0 to continue. Returns number of records replayed, -1 on error. */
+typedef int (*WalReplayFn)(int type, const unsigned char *payload, size_t len, void *ctx);
+int    wal_replay(WalReplayFn fn, void *ctx);
+
+/* Empty the log once its records are folded into the commit table */
+int    wal_reset(void);
+
+#endif /* WAL_H */
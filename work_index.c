@@ -0,0 +1,260 @@
+#define _POSIX_C_SOURCE 200809L
+#ifdef __APPLE__
+#define _DARWIN_C_SOURCE            // st_mtimespec
+#endif
+
+#include "work_index.h"
+#include "bytebuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap, munmap
+
+/*   header  "MGITIDX" version(1) count(4) written_at(8)
+ *   entry   size(8) mtime_sec(8) mtime_nsec(4) ino(8) hash(20) path_len(2) path
+ *   entries sorted by path */
+#define INDEX_MAGIC     "MGITIDX"
+#define INDEX_VERSION   1
+#define HEADER_SIZE     20
+#define MIN_ENTRY_SIZE  50
+
+#ifdef __APPLE__
+#define STAT_MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#endif
+
+/* =============== LOOKUP =================== */
+
+/* Binary search; returns the slot where path is or would be inserted */
+static int find_slot(const WorkIndex *wi, const char *path, int *found) {
+    int lo = 0, hi = wi->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(wi->entries[mid].path, path);
+        if (cmp == 0) {
+            *found = 1;
+            return mid;
+        }
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *found = 0;
+    return lo;
+}
+
+WorkIndexEntry *work_index_find(WorkIndex *wi, const char *path) {
+    int found;
+    int slot = find_slot(wi, path, &found);
+    return found ? &wi->entries[slot] : NULL;
+}
+
+static int stat_matches(const WorkIndexEntry *e, const struct stat *st) {
+    return e->size == (uint64_t)st->st_size &&
+           e->mtime_sec == (int64_t)st->st_mtime &&
+           e->mtime_nsec == (int64_t)STAT_MTIME_NSEC(st) &&
+           e->ino == (uint64_t)st->st_ino;
+}
+
+WorkIndexEntry *work_index_lookup(WorkIndex *wi, const char *path, const struct stat *st) {
+    WorkIndexEntry *e = work_index_find(wi, path);
+    if (!e) return NULL;
+
+    e->seen = 1;
+    if (!stat_matches(e, st)) return NULL;
+
+    /* Written in the same second as the cache: a later edit within that
+       second would keep the same mtime, so the hash cannot be trusted */
+    if (e->mtime_sec >= wi->written_at) return NULL;
+    return e;
+}
+
+/* =============== UPDATE =================== */
+
+static WorkIndexEntry *insert_at(WorkIndex *wi, int slot, const char *path) {
+    if (wi->count == wi->cap) {
+        int cap = wi->cap ? wi->cap * 2 : 64;
+        WorkIndexEntry *p = realloc(wi->entries, (size_t)cap * sizeof(WorkIndexEntry));
+        if (!p) return NULL;
+        wi->entries = p;
+        wi->cap = cap;
+    }
+
+    size_t len = strlen(path);
+    char *copy = malloc(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, path, len + 1);
+
+    memmove(&wi->entries[slot + 1], &wi->entries[slot],
+            (size_t)(wi->count - slot) * sizeof(WorkIndexEntry));
+    wi->count++;
+
+    WorkIndexEntry *e = &wi->entries[slot];
+    memset(e, 0, sizeof(*e));
+    e->path = copy;
+    return e;
+}
+
+WorkIndexEntry *work_index_update(WorkIndex *wi, const char *path,
+                                  const struct stat *st, const ObjectId *id) {
+    int found;
+    int slot = find_slot(wi, path, &found);
+    WorkIndexEntry *e = found ? &wi->entries[slot] : insert_at(wi, slot, path);
+    if (!e) return NULL;
+
+    if (!object_id_equal(&e->id, id))
+        e->indexed = 0;           // content changed: search index is stale
+
+    e->size = (uint64_t)st->st_size;
+    e->mtime_sec = (int64_t)st->st_mtime;
+    e->mtime_nsec = (int64_t)STAT_MTIME_NSEC(st);
+    e->ino = (uint64_t)st->st_ino;
+    e->id = *id;
+    e->seen = 1;
+    wi->dirty = 1;
+    return e;
+}
+
+void work_index_remove(WorkIndex *wi, const char *path) {
+    int found;
+    int slot = find_slot(wi, path, &found);
+    if (!found) return;
+
+    free(wi->entries[slot].path);
+    memmove(&wi->entries[slot], &wi->entries[slot + 1],
+            (size_t)(wi->count - slot - 1) * sizeof(WorkIndexEntry));
+    wi->count--;
+    wi->dirty = 1;
+}
+
+int work_index_prune(WorkIndex *wi, const char *dir_prefix) {
+    size_t plen = strlen(dir_prefix);
+    int kept = 0, dropped = 0;
+
+    for (int i = 0; i < wi->count; i++) {
+        WorkIndexEntry *e = &wi->entries[i];
+        if (!e->seen && strncmp(e->path, dir_prefix, plen) == 0) {
+            free(e->path);
+            dropped++;
+            continue;
+        }
+        e->seen = 0;
+        wi->entries[kept++] = *e;
+    }
+    wi->count = kept;
+    if (dropped) wi->dirty = 1;
+    return dropped;
+}
+
+/* =============== LOAD / SAVE =================== */
+
+void work_index_clear(WorkIndex *wi) {
+    for (int i = 0; i < wi->count; i++)
+        free(wi->entries[i].path);
+    free(wi->entries);
+    memset(wi, 0, sizeof(*wi));
+}
+
+int work_index_load(WorkIndex *wi, const char *path) {
+    work_index_clear(wi);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;               // no cache yet: everything is re-read
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    Reader rd = { (const unsigned char *)map, (const unsigned char *)map + len, 1 };
+
+    const unsigned char *magic = rd_bytes(&rd, 7);
+    int version = (int)rd_uint(&rd, 1);
+    uint32_t count = (uint32_t)rd_uint(&rd, 4);
+    wi->written_at = (int64_t)rd_uint(&rd, 8);
+
+    if (!rd.ok || memcmp(magic, INDEX_MAGIC, 7) != 0 || version != INDEX_VERSION ||
+        count > (size_t)(rd.end - rd.p) / MIN_ENTRY_SIZE) {
+        munmap(map, len);
+        wi->written_at = 0;
+        return -1;
+    }
+
+    wi->entries = count ? malloc(count * sizeof(WorkIndexEntry)) : NULL;
+    if (count && !wi->entries) {
+        munmap(map, len);
+        return -1;
+    }
+    wi->cap = (int)count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        WorkIndexEntry *e = &wi->entries[wi->count];
+        memset(e, 0, sizeof(*e));
+        e->size = rd_uint(&rd, 8);
+        e->mtime_sec = (int64_t)rd_uint(&rd, 8);
+        e->mtime_nsec = (int64_t)rd_uint(&rd, 4);
+        e->ino = rd_uint(&rd, 8);
+        const unsigned char *hash = rd_bytes(&rd, OBJECT_ID_RAWSZ);
+        size_t name_len = (size_t)rd_uint(&rd, 2);
+        const unsigned char *name = rd_bytes(&rd, name_len);
+        if (!rd.ok) break;
+
+        memcpy(e->id.hash, hash, OBJECT_ID_RAWSZ);
+        e->path = malloc(name_len + 1);
+        if (!e->path) break;
+        memcpy(e->path, name, name_len);
+        e->path[name_len] = '\0';
+        wi->count++;
+    }
+
+    munmap(map, len);
+    if ((uint32_t)wi->count != count) {
+        /* A partial cache is still sorted and valid; rewrite it */
+        wi->dirty = 1;
+        return -1;
+    }
+    return wi->count;
+}
+
+int work_index_save(WorkIndex *wi, const char *path) {
+    ByteBuf b = {0};
+    int64_t now = (int64_t)time(NULL);
+
+    buf_put(&b, INDEX_MAGIC, 7);
+    buf_put_uint(&b, INDEX_VERSION, 1);
+    buf_put_uint(&b, (uint32_t)wi->count, 4);
+    buf_put_uint(&b, (uint64_t)now, 8);
+
+    for (int i = 0; i < wi->count; i++) {
+        const WorkIndexEntry *e = &wi->entries[i];
+        size_t name_len = strlen(e->path);
+        if (name_len > 0xffff) name_len = 0xffff;
+
+        buf_put_uint(&b, e->size, 8);
+        buf_put_uint(&b, (uint64_t)e->mtime_sec, 8);
+        buf_put_uint(&b, (uint64_t)e->mtime_nsec, 4);
+        buf_put_uint(&b, e->ino, 8);
+        buf_put(&b, e->id.hash, OBJECT_ID_RAWSZ);
+        buf_put_uint(&b, name_len, 2);
+        buf_put(&b, e->path, name_len);
+    }
+
+    int rc = b.failed ? -1 : write_file_atomic(path, b.data, b.len);
+    buf_free(&b);
+    if (rc == 0) {
+        wi->written_at = now;
+        wi->dirty = 0;
+    }
+    return rc;
+}
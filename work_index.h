@@ -0,0 +1,55 @@
+#ifndef WORK_INDEX_H
+#define WORK_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "object_store.h"
+
+/* -------- Stat cache of the working tree (.mgit/index) -------- */
+/* One entry per file that was hashed: if size, mtime and inode still
+   match, the recorded content hash is trusted and the file is not read.
+   Entries modified in the same second the cache was written are
+   "racily clean" and always re-read (same rule as git). */
+typedef struct WorkIndexEntry {
+    char *path;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t ino;
+    ObjectId id;
+
+    int seen;                     // touched by the current sweep
+    int indexed;                  // fed to the search index this session
+} WorkIndexEntry;
+
+typedef struct WorkIndex {
+    WorkIndexEntry *entries;      // sorted by path
+    int count;
+    int cap;
+    int64_t written_at;           // when the cache file was last written
+    int dirty;
+} WorkIndex;
+
+/* Returns number of entries loaded, 0 if missing, -1 if corrupt */
+int  work_index_load(WorkIndex *wi, const char *path);
+int  work_index_save(WorkIndex *wi, const char *path);     // 0 on success
+void work_index_clear(WorkIndex *wi);
+
+WorkIndexEntry *work_index_find(WorkIndex *wi, const char *path);
+
+/* Entry for path if st still matches it (content unchanged), else NULL */
+WorkIndexEntry *work_index_lookup(WorkIndex *wi, const char *path, const struct stat *st);
+
+/* Record that path (in state st) has content id */
+WorkIndexEntry *work_index_update(WorkIndex *wi, const char *path,
+                                  const struct stat *st, const ObjectId *id);
+
+void work_index_remove(WorkIndex *wi, const char *path);
+
+/* Drop entries under dir_prefix that the last sweep did not see,
+   and reset the seen flags. Returns number of entries dropped. */
+int  work_index_prune(WorkIndex *wi, const char *dir_prefix);
+
+#endif /* WORK_INDEX_H */
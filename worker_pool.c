@@ -0,0 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "worker_pool.h"
+
+#include <pthread.h>
+#include <unistd.h>     // sysconf
+
+typedef struct Pool {
+    PoolTask fn;
+    void *ctx;
+    int count;
+    int next;                     // next unclaimed item
+    pthread_mutex_t lock;
+} Pool;
+
+static void *worker_main(void *arg) {
+    Pool *pool = (Pool *)arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        int i = pool->next < pool->count ? pool->next++ : -1;
+        pthread_mutex_unlock(&pool->lock);
+        if (i < 0) break;
+        pool->fn(pool->ctx, i);
+    }
+    return NULL;
+}
+
+static int worker_count(int items) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = cpus > 0 ? (int)cpus : 1;
+    if (n > POOL_MAX_THREADS) n = POOL_MAX_THREADS;
+    return n < items ? n : items;
+}
+
+int parallel_for(int count, PoolTask fn, void *ctx) {
+    int nthreads = worker_count(count);
+    if (nthreads <= 1) {
+        for (int i = 0; i < count; i++) fn(ctx, i);
+        return count > 0 ? 1 : 0;
+    }
+
+    Pool pool = { fn, ctx, count, 0, PTHREAD_MUTEX_INITIALIZER };
+    pthread_t threads[POOL_MAX_THREADS];
+    int started = 0;
+
+    /* The caller is the last worker, which also covers create failures */
+    for (int t = 0; t < nthreads - 1; t++) {
+        if (pthread_create(&threads[t], NULL, worker_main, &pool) != 0) break;
+        started++;
+    }
+    worker_main(&pool);
+
+    for (int t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&pool.lock);
+    return started + 1;
+}
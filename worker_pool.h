@@ -0,0 +1,14 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#define POOL_MAX_THREADS 8
+
+/* -------- Run fn(ctx, i) for i in [0, count) on a pool of threads -------- */
+/* Items are claimed one at a time, so uneven sizes balance out. The
+   caller's thread is one of the workers; fn must not touch state shared
+   between items. Returns the number of threads used. */
+typedef void (*PoolTask)(void *ctx, int i);
+
+int parallel_for(int count, PoolTask fn, void *ctx);
+
+#endif /* WORKER_POOL_H */